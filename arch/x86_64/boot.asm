@@ -1,7 +1,11 @@
 ; -----------------------------------------------------------------------------
 ; Multiboot2 x86_64 boot stub (NASM)
-; GRUB -> protected mode -> long mode -> kernel_main
-; Identity maps 0–4 GiB using 4 PDs (2 MiB pages)
+; GRUB -> protected mode -> long mode -> higher half -> kernel_main
+; Maps 0–4 GiB using 4 PDs (2 MiB pages) both at 0 (identity, only until
+; the VMM drops it) and at DIRECT_MAP_BASE, plus the kernel image at
+; KERNEL_VIRT_BASE through a PD of its own, so no leaf entry is shared
+; with the direct map. The kernel is linked at KERNEL_VIRT_BASE + 1 MiB, so
+; everything before the jump to the higher half uses V2P() addresses.
 ; -----------------------------------------------------------------------------
 
 %define MULTIBOOT2_MAGIC          0xE85250D6
@@ -10,17 +14,30 @@
 %define STACK_SIZE               16384
 %define PAGE_SIZE                0x1000
 
-%define PAGING_BASE              0x200000
-%define PML4_ADDR                (PAGING_BASE + 0x0000)
-%define PDP_ADDR                 (PAGING_BASE + 0x1000)
-%define PD0_ADDR                 (PAGING_BASE + 0x2000)
-%define PD1_ADDR                 (PAGING_BASE + 0x3000)
-%define PD2_ADDR                 (PAGING_BASE + 0x4000)
-%define PD3_ADDR                 (PAGING_BASE + 0x5000)
+; Must match include/mm/memlayout.h
+%define KERNEL_VIRT_BASE         0xFFFFFFFF80000000
+%define V2P(addr)                ((addr) - KERNEL_VIRT_BASE)
+%define PML4_DIRECT_MAP          256     ; DIRECT_MAP_BASE
+%define PML4_KERNEL              511     ; KERNEL_VIRT_BASE
+%define PDP_KERNEL               510
+
+; Page tables live in .bss so they stay inside the kernel image the PMM
+; reserves; the VMM keeps using them after boot
+%define PML4_ADDR                V2P(boot_page_tables + 0x0000)
+%define PDP_ADDR                 V2P(boot_page_tables + 0x1000)
+%define PD0_ADDR                 V2P(boot_page_tables + 0x2000)
+%define PD1_ADDR                 V2P(boot_page_tables + 0x3000)
+%define PD2_ADDR                 V2P(boot_page_tables + 0x4000)
+%define PD3_ADDR                 V2P(boot_page_tables + 0x5000)
+%define PDP_HIGH_ADDR            V2P(boot_page_tables + 0x6000)
+%define PD_KERNEL_ADDR           V2P(boot_page_tables + 0x7000)
+%define BOOT_TABLE_PAGES         8
 
 %define PF_PRESENT               0x1
 %define PF_WRITABLE              0x2
 %define PF_PS                    (1 << 7)
+%define LARGE_PAGE_SHIFT         21
+%define PF_GLOBAL                (1 << 8)   ; Ignored until vmm_init sets CR4.PGE
 
 %define CR4_PAE                  (1 << 5)
 %define CR0_PG                   (1 << 31)
@@ -64,6 +81,10 @@ mb_header_end:
 ; BSS
 ; -----------------------------------------------------------------------------
 section .bss
+align 4096
+boot_page_tables:
+    resb BOOT_TABLE_PAGES * PAGE_SIZE
+
 align 16
 stack_bottom:
     resb STACK_SIZE
@@ -82,47 +103,57 @@ global _start
 
 _start:
     cli
-    mov esp, stack_top
+    mov esp, V2P(stack_top)
 
-    ; Save Multiboot2 info pointer
-    mov dword [multiboot_info_ptr], ebx
-    mov dword [multiboot_info_ptr + 4], 0
+    ; Save Multiboot2 info pointer (physical)
+    mov dword [V2P(multiboot_info_ptr)], ebx
+    mov dword [V2P(multiboot_info_ptr) + 4], 0
 
     ; Validate Multiboot2 magic
     cmp eax, MULTIBOOT2_BOOTLOADER
     jne fatal_error
 
-    ; Load 64-bit GDT (used for both PM and LM)
-    lgdt [gdt_ptr]
+    ; Load 64-bit GDT (used for both PM and LM) from its physical address
+    lgdt [V2P(gdt_ptr32)]
 
     call setup_page_tables
     call enable_long_mode
 
     ; Far jump enables long mode
-    jmp 0x08:long_mode_entry
+    jmp 0x08:V2P(long_mode_entry)
 
 ; -----------------------------------------------------------------------------
-; Page tables: PML4 -> PDP -> 4×PD (4 GiB identity map)
+; Page tables: PML4 -> PDP -> 4×PD (4 GiB, identity and direct map)
+;              PML4 -> PDP_HIGH -> PD_KERNEL (kernel image only)
 ; -----------------------------------------------------------------------------
+extern _kernel_end
+
 setup_page_tables:
-    ; Clear PML4 + PDP + 4 PDs = 6 pages
-    mov edi, PAGING_BASE
-    mov ecx, 6 * (PAGE_SIZE / 4)
+    ; Clear PML4 + 2 PDPs + 5 PDs = 8 pages
+    mov edi, V2P(boot_page_tables)
+    mov ecx, BOOT_TABLE_PAGES * (PAGE_SIZE / 4)
     xor eax, eax
     rep stosd
 
-    ; PML4[0] -> PDP
-    mov eax, PDP_ADDR | PF_PRESENT | PF_WRITABLE
+    ; PML4[0] and PML4[PML4_DIRECT_MAP] -> PDP
+    mov eax, PDP_ADDR + (PF_PRESENT | PF_WRITABLE)
     mov [PML4_ADDR], eax
+    mov [PML4_ADDR + PML4_DIRECT_MAP*8], eax
+
+    ; PML4[PML4_KERNEL] -> PDP_HIGH, PDP_HIGH[PDP_KERNEL] -> PD_KERNEL
+    mov eax, PDP_HIGH_ADDR + (PF_PRESENT | PF_WRITABLE)
+    mov [PML4_ADDR + PML4_KERNEL*8], eax
+    mov eax, PD_KERNEL_ADDR + (PF_PRESENT | PF_WRITABLE)
+    mov [PDP_HIGH_ADDR + PDP_KERNEL*8], eax
 
     ; PDP[0..3] -> PDs
-    mov eax, PD0_ADDR | PF_PRESENT | PF_WRITABLE
+    mov eax, PD0_ADDR + (PF_PRESENT | PF_WRITABLE)
     mov [PDP_ADDR + 0*8], eax
-    mov eax, PD1_ADDR | PF_PRESENT | PF_WRITABLE
+    mov eax, PD1_ADDR + (PF_PRESENT | PF_WRITABLE)
     mov [PDP_ADDR + 1*8], eax
-    mov eax, PD2_ADDR | PF_PRESENT | PF_WRITABLE
+    mov eax, PD2_ADDR + (PF_PRESENT | PF_WRITABLE)
     mov [PDP_ADDR + 2*8], eax
-    mov eax, PD3_ADDR | PF_PRESENT | PF_WRITABLE
+    mov eax, PD3_ADDR + (PF_PRESENT | PF_WRITABLE)
     mov [PDP_ADDR + 3*8], eax
 
     ; Map 4 GiB using 2 MiB pages
@@ -133,8 +164,8 @@ setup_page_tables:
     mov ecx, 512
 %%loop:
     mov eax, ebx
-    shl eax, 21
-    or eax, PF_PRESENT | PF_WRITABLE | PF_PS
+    shl eax, LARGE_PAGE_SHIFT
+    or eax, PF_PRESENT | PF_WRITABLE | PF_PS | PF_GLOBAL
     mov [edi], eax
     mov dword [edi + 4], 0
     add edi, 8
@@ -147,6 +178,21 @@ setup_page_tables:
     MAP_PD PD2_ADDR
     MAP_PD PD3_ADDR
 
+    ; Kernel image: the 2 MiB pages from 0 up to _kernel_end
+    mov edi, PD_KERNEL_ADDR
+    mov ecx, V2P(_kernel_end) + (1 << LARGE_PAGE_SHIFT) - 1
+    shr ecx, LARGE_PAGE_SHIFT
+    xor ebx, ebx
+.map_kernel:
+    mov eax, ebx
+    shl eax, LARGE_PAGE_SHIFT
+    or eax, PF_PRESENT | PF_WRITABLE | PF_PS | PF_GLOBAL
+    mov [edi], eax
+    mov dword [edi + 4], 0
+    add edi, 8
+    inc ebx
+    loop .map_kernel
+
     ret
 
 ; -----------------------------------------------------------------------------
@@ -189,11 +235,19 @@ fatal_error:
     jmp .hang
 
 ; -----------------------------------------------------------------------------
-; 64-bit entry point
+; 64-bit entry point (still running at the physical address)
 ; -----------------------------------------------------------------------------
 bits 64
 default rel
 long_mode_entry:
+    mov rax, higher_half_entry
+    jmp rax
+
+higher_half_entry:
+    ; Reload the GDT through its higher half address before the identity
+    ; map goes away
+    lgdt [gdt_ptr]
+
     ; Load data segments
     mov ax, 0x10
     mov ds, ax
@@ -207,7 +261,7 @@ long_mode_entry:
     and rsp, -16
     sub rsp, 8
 
-    ; Pass Multiboot2 info pointer
+    ; Pass Multiboot2 info pointer (physical)
     mov rdi, [multiboot_info_ptr]
 
     extern kernel_main
@@ -230,6 +284,10 @@ gdt_start:
     dq 0x0000920000000000        ; Data
 gdt_end:
 
+gdt_ptr32:
+    dw gdt_end - gdt_start - 1
+    dd V2P(gdt_start)
+
 gdt_ptr:
     dw gdt_end - gdt_start - 1
     dq gdt_start
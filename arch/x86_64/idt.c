@@ -1,7 +1,10 @@
 #include <arch/x86_64/idt.h>
 #include <arch/x86_64/pic.h>
 #include <arch/x86_64/pit.h>
+#include <arch/x86_64/lapic.h>
+#include <arch/x86_64/timer.h>
 #include <arch/x86_64/ports.h>
+#include <mm/vmm.h>
 #include <ui/console.h>
 #include <drivers/input/keyboard.h>
 
@@ -23,6 +26,7 @@ extern void irq0(void); extern void irq1(void); extern void irq2(void); extern v
 extern void irq4(void); extern void irq5(void); extern void irq6(void); extern void irq7(void);
 extern void irq8(void); extern void irq9(void); extern void irq10(void); extern void irq11(void);
 extern void irq12(void); extern void irq13(void); extern void irq14(void); extern void irq15(void);
+extern void irq16(void); extern void isr_spurious(void);
 
 // Internal Function Declarations
 static void idt_set_gate(uint8_t num, uint64_t base, uint16_t sel, uint8_t flags);
@@ -126,6 +130,12 @@ void idt_init(void) {
         }
     }
     
+    // Install Local APIC Handlers
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint64_t)irq16, KERNEL_CS,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint64_t)isr_spurious, KERNEL_CS,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE);
+    
     // Load IDT
     idt_load((uint64_t)&idt_ptr);
     
@@ -141,6 +151,15 @@ void idt_init(void) {
 }
 
 void isr_handler(registers_t* regs) {
+    // Page faults in demand-zero regions just need a page mapped
+    if (regs->int_no == 14) {
+        uint64_t fault_address;
+        __asm__ volatile("mov %%cr2, %0" : "=r"(fault_address));
+        if (vmm_handle_page_fault(fault_address, regs->err_code) == 0) {
+            return;
+        }
+    }
+    
     console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
     
     if (regs->int_no < 32) {
@@ -174,6 +193,13 @@ void isr_handler(registers_t* regs) {
 }
 
 void irq_handler(registers_t* regs) {
+    // Handle Local APIC Timer (acknowledged at the APIC, not the PIC)
+    if (regs->int_no == LAPIC_TIMER_VECTOR) {
+        timer_handler();
+        lapic_eoi();
+        return;
+    }
+    
     // Handle PIT
     if (regs->int_no == 32) {
         pit_handler();
@@ -191,12 +217,9 @@ void irq_handler(registers_t* regs) {
 }
 
 uint32_t get_timer_ticks(void) {
-    return pit_get_ticks();
+    return (uint32_t)timer_get_ms();
 }
 
 void sleep_ms(uint32_t ms) {
-    uint32_t target = get_timer_ticks() + ms;
-    while (get_timer_ticks() < target) {
-        __asm__ volatile("pause");
-    }
+    timer_sleep_ms(ms);
 }
@@ -163,6 +163,12 @@ IRQ 12, 44
 IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
+IRQ 16, 48      ; Local APIC timer (LAPIC_TIMER_VECTOR)
+
+; Spurious local APIC interrupt: nothing to handle, no EOI
+global isr_spurious
+isr_spurious:
+    iretq
 
 ; Common Handlers
 isr_common:
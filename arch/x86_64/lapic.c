@@ -0,0 +1,90 @@
+#include <arch/x86_64/lapic.h>
+#include <arch/x86_64/cpu.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <ui/console.h>
+
+#define CPUID_APIC         (1 << 9)   // 0x1 EDX
+#define CPUID_TSC_DEADLINE (1 << 24)  // 0x1 ECX
+
+// Registers, through the (uncached) direct map
+static volatile uint32_t* lapic = NULL;
+static int tsc_deadline = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+int lapic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_APIC)) {
+        return -1;
+    }
+    tsc_deadline = (ecx & CPUID_TSC_DEADLINE) != 0;
+    
+    uint64_t apic_base = rdmsr(MSR_APIC_BASE);
+    uint64_t phys = apic_base & 0x000FFFFFFFFFF000ULL;
+    
+    // The registers are MMIO: their direct map page must not be cached
+    if (vmm_map_range((uint64_t)phys_to_virt(phys), phys, PAGE_SIZE,
+                      PAGE_PRESENT | PAGE_WRITABLE | PAGE_CACHE_DISABLE | PAGE_WRITETHROUGH) != 0) {
+        return -1;
+    }
+    wrmsr(MSR_APIC_BASE, apic_base | APIC_BASE_ENABLE);
+    lapic = (volatile uint32_t*)phys_to_virt(phys);
+    
+    // PIC interrupts keep coming in through LINT0 (virtual wire mode)
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_EXTINT);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_NMI);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("[LAPIC] Enabled at ");
+    console_write_hex64(phys);
+    console_write(tsc_deadline ? " (TSC-deadline timer)\n" : "\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    return 0;
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+int lapic_has_tsc_deadline(void) {
+    return tsc_deadline;
+}
+
+void lapic_timer_oneshot(uint32_t count) {
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, count ? count : 1);
+}
+
+void lapic_timer_deadline(uint64_t tsc) {
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_LVT_TSC_DEADLINE);
+    
+    // The LVT write has to land before the deadline is armed
+    __asm__ volatile("mfence" ::: "memory");
+    wrmsr(MSR_TSC_DEADLINE, tsc ? tsc : 1);
+}
+
+void lapic_timer_free_run(void) {
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+}
+
+uint32_t lapic_timer_current(void) {
+    return lapic_read(LAPIC_REG_TIMER_CUR);
+}
+
+void lapic_timer_stop(void) {
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+}
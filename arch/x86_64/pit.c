@@ -1,8 +1,11 @@
 #include <arch/x86_64/pit.h>
+#include <arch/x86_64/pic.h>
+#include <arch/x86_64/timer.h>
 #include <arch/x86_64/ports.h>
 #include <ui/console.h>
 
-volatile uint32_t pit_ticks = 0;
+volatile uint64_t pit_ticks = 0;
+static int pit_running = 0;
 
 void pit_init(uint32_t frequency) {
     console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
@@ -17,6 +20,7 @@ void pit_init(uint32_t frequency) {
     outb(PIT_CHANNEL0_DATA, (divisor >> 8) & 0xFF);
     
     pit_ticks = 0;
+    pit_running = 1;
     
     console_write("[PIT] Initialized at ");
     //console_write_dec(frequency);
@@ -24,13 +28,20 @@ void pit_init(uint32_t frequency) {
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
 }
 
-uint32_t pit_get_ticks(void) {
+uint64_t pit_get_ticks(void) {
     return pit_ticks;
 }
 
 void pit_sleep(uint32_t ms) {
-    uint32_t target = pit_ticks + ms;
-    while (pit_ticks < target) {
+    // Once the local APIC timer has taken over, no more ticks will come
+    if (!pit_running) {
+        timer_sleep_ms(ms);
+        return;
+    }
+    
+    // Elapsed ticks, so a counter wrap can't end the wait early or late
+    uint64_t start = pit_ticks;
+    while (pit_ticks - start < ms) {
         __asm__ volatile("hlt");
     }
 }
@@ -43,6 +54,13 @@ void pit_set_frequency(uint32_t frequency) {
     outb(PIT_CHANNEL0_DATA, (divisor >> 8) & 0xFF);
 }
 
+void pit_stop(void) {
+    // Mode 0 with no count loaded never raises another interrupt
+    outb(PIT_COMMAND, PIT_CHANNEL0 | PIT_LOBYTE | PIT_HIBYTE | PIT_MODE0);
+    pic_set_mask(0);
+    pit_running = 0;
+}
+
 void pit_handler(void) {
     pit_ticks++;
 }
@@ -0,0 +1,181 @@
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/lapic.h>
+#include <arch/x86_64/pit.h>
+#include <arch/x86_64/cpu.h>
+#include <ui/console.h>
+
+#define NO_WAKEUP UINT64_MAX
+
+#define NS_PER_MS 1000000ULL
+
+#define CPUID_INVARIANT_TSC (1 << 8)    // 0x80000007 EDX: TSC rate never changes
+
+static int lapic_ok = 0;
+static int tickless = 0;
+static int use_deadline = 0;
+static uint64_t lapic_per_ms = 0;       // APIC timer counts (bus clock / 16)
+
+// TSC clock: once calibrated it continues from the PIT tick count it took
+// over from. tsc_mult is nanoseconds per TSC cycle in 32.32 fixed point.
+static int tsc_clock = 0;
+static uint64_t tsc_per_ms = 0;
+static uint64_t tsc_mult = 0;
+static uint64_t tsc_base = 0;
+static uint64_t ns_base = 0;
+
+static volatile uint64_t wakeup_ms = NO_WAKEUP;   // Armed expiry
+
+// Helper: Time the TSC (and the APIC timer) over TIMER_CALIBRATE_MS PIT ticks
+static void timer_calibrate(void) {
+    // Start right on a tick edge
+    uint64_t start = pit_get_ticks();
+    while (pit_get_ticks() == start) {
+        __asm__ volatile("hlt");
+    }
+    
+    uint64_t tsc_start = rdtsc();
+    if (lapic_ok) {
+        lapic_timer_free_run();
+    }
+    
+    start = pit_get_ticks();
+    while (pit_get_ticks() - start < TIMER_CALIBRATE_MS) {
+        __asm__ volatile("hlt");
+    }
+    
+    tsc_per_ms = (rdtsc() - tsc_start) / TIMER_CALIBRATE_MS;
+    if (lapic_ok) {
+        lapic_per_ms = (0xFFFFFFFFULL - lapic_timer_current()) / TIMER_CALIBRATE_MS;
+        lapic_timer_stop();
+    }
+}
+
+// Helper: Only a TSC that ticks at a fixed rate through halts and
+// frequency changes can keep time, and only the CPUID bit promises that
+static int tsc_is_stable(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000007) {
+        return 0;
+    }
+    cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_INVARIANT_TSC) != 0;
+}
+
+// Helper: Clock reading at a given TSC value
+static inline uint64_t tsc_to_ns(uint64_t tsc) {
+    return ns_base + (uint64_t)(((unsigned __int128)(tsc - tsc_base) * tsc_mult) >> 32);
+}
+
+void timer_init(void) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("[TIMER] Initializing...\n");
+    
+    lapic_ok = (lapic_init() == 0);
+    timer_calibrate();
+    
+    // Hand the clock over to the TSC
+    if (tsc_per_ms && tsc_is_stable()) {
+        uint64_t flags = irq_save();
+        tsc_mult = (NS_PER_MS << 32) / tsc_per_ms;
+        ns_base = pit_get_ticks() * NS_PER_MS;
+        tsc_base = rdtsc();
+        tsc_clock = 1;
+        irq_restore(flags);
+        
+        console_write("[TIMER] Clock: TSC at ");
+        console_write_dec(tsc_per_ms / 1000);
+        console_write(" MHz\n");
+    } else {
+        console_write("[TIMER] Clock: PIT ticks (TSC not stable)\n");
+    }
+    
+    // Without ticks the clock has to come from the TSC
+    if (!tsc_clock || !lapic_ok || !lapic_per_ms) {
+        console_write("[TIMER] No usable local APIC timer, PIT stays at 1000 Hz\n");
+        console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+        return;
+    }
+    
+    // Stop the periodic tick
+    uint64_t flags = irq_save();
+    pit_stop();
+    use_deadline = lapic_has_tsc_deadline();
+    tickless = 1;
+    irq_restore(flags);
+    
+    console_write("[TIMER] Tickless, ");
+    console_write(use_deadline ? "TSC-deadline" : "APIC one-shot");
+    console_write(" timer\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+}
+
+int timer_is_tickless(void) {
+    return tickless;
+}
+
+uint64_t clock_monotonic_ns(void) {
+    if (!tsc_clock) {
+        return pit_get_ticks() * NS_PER_MS;
+    }
+    return tsc_to_ns(rdtsc());
+}
+
+uint64_t timer_get_ms(void) {
+    return clock_monotonic_ns() / NS_PER_MS;
+}
+
+void timer_set_wakeup(uint64_t ms) {
+    if (!tickless) {
+        return;  // The PIT wakes us every millisecond anyway
+    }
+    
+    uint64_t flags = irq_save();
+    if (wakeup_ms <= ms) {
+        irq_restore(flags);
+        return;  // Something earlier is armed already
+    }
+    wakeup_ms = ms;
+    
+    // TSC cycles until the clock reads ms, rounded up so the interrupt
+    // never comes early. Far off wakeups are cut short; the sleeper arms
+    // again when it finds it is not due yet.
+    uint64_t now = rdtsc();
+    uint64_t now_ns = tsc_to_ns(now);
+    uint64_t delta_ns = (ms * NS_PER_MS > now_ns) ? ms * NS_PER_MS - now_ns : 0;
+    if (delta_ns > TIMER_MAX_ARM_MS * NS_PER_MS) {
+        delta_ns = TIMER_MAX_ARM_MS * NS_PER_MS;
+    }
+    uint64_t delta = (delta_ns * tsc_per_ms + NS_PER_MS - 1) / NS_PER_MS + 1;
+    
+    if (use_deadline) {
+        lapic_timer_deadline(now + delta);
+    } else {
+        uint64_t count = (delta * lapic_per_ms + tsc_per_ms - 1) / tsc_per_ms;
+        lapic_timer_oneshot(count > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)count);
+    }
+    irq_restore(flags);
+}
+
+void timer_idle(void) {
+    __asm__ volatile("sti; hlt" ::: "memory");
+}
+
+void timer_sleep_ms(uint32_t ms) {
+    uint64_t target = timer_get_ms() + ms;
+    
+    // Halting needs interrupts, but hand back the caller's IF as it was
+    uint64_t flags = irq_save();
+    while (timer_get_ms() < target) {
+        timer_set_wakeup(target);
+        timer_idle();
+        __asm__ volatile("cli");
+    }
+    irq_restore(flags);
+}
+
+void timer_handler(void) {
+    // One-shot: nothing is armed any more
+    wakeup_ms = NO_WAKEUP;
+}
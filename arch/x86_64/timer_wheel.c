@@ -0,0 +1,276 @@
+#include <arch/x86_64/timer_wheel.h>
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/cpu.h>
+
+#define WHEEL_MASK  (TIMER_WHEEL_SIZE - 1)
+#define WHEEL_RANGE (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))
+
+#define NO_TIMER UINT64_MAX
+
+// Level n slot i holds timers due in the 2^(6n) ms starting wherever the
+// clock next has i in bits 6n..6n+5. Level 0 slots are single
+// milliseconds and run when reached; higher slots are cascaded one level
+// down whenever the level below wraps around.
+static ktimer_t* wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static uint64_t wheel_clock = 0;        // Next millisecond to process
+static uint64_t next_run = NO_TIMER;    // When timer_run next has work
+static uint32_t pending = 0;
+static uint32_t level0_pending = 0;
+static uint64_t fired = 0;
+static uint64_t cascaded = 0;
+
+// Timers added while timer_run is running callbacks wait here and are
+// filed once it has caught up, so one re-added for now fires next run
+static ktimer_t* deferred = NULL;
+static int running = 0;
+
+static inline int in_level0(ktimer_t** slot) {
+    return slot >= &wheel[0][0] && slot < &wheel[0][TIMER_WHEEL_SIZE];
+}
+
+static void timer_list_add(ktimer_t** head, ktimer_t* timer) {
+    timer->prev = NULL;
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    *head = timer;
+    timer->slot = head;
+    
+    if (in_level0(head)) {
+        level0_pending++;
+    }
+}
+
+static void timer_list_remove(ktimer_t* timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    
+    if (in_level0(timer->slot)) {
+        level0_pending--;
+    }
+    timer->slot = NULL;
+}
+
+// Helper: File a timer in the slot its expiry falls in, relative to the
+// wheel clock. Returns when the wheel has to look at that slot.
+static uint64_t wheel_insert(ktimer_t* timer) {
+    uint64_t expires = timer->expires;
+    if (expires < wheel_clock) {
+        expires = wheel_clock;  // Overdue: next run
+    }
+    
+    // Further out than the wheel reaches: park it in the last slot, it is
+    // filed again when that slot cascades
+    uint64_t delta = expires - wheel_clock;
+    if (delta >= WHEEL_RANGE) {
+        expires = wheel_clock + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+    
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1ULL << ((level + 1) * TIMER_WHEEL_BITS))) {
+        level++;
+    }
+    
+    int shift = level * TIMER_WHEEL_BITS;
+    timer_list_add(&wheel[level][(expires >> shift) & WHEEL_MASK], timer);
+    return (expires >> shift) << shift;
+}
+
+// Helper: Refile one higher-level slot as the clock enters it
+static void wheel_cascade(int level, uint32_t index) {
+    ktimer_t* timer;
+    
+    while ((timer = wheel[level][index]) != NULL) {
+        timer_list_remove(timer);
+        wheel_insert(timer);
+        cascaded++;
+    }
+}
+
+// Helper: Earliest time any slot needs attention: the first filled level
+// 0 slot, or a higher slot that is due to cascade before it
+static uint64_t wheel_next_expiry(void) {
+    uint64_t next = NO_TIMER;
+    
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        int shift = level * TIMER_WHEEL_BITS;
+        uint64_t base = wheel_clock >> shift;
+        
+        // Once the clock is past the start of a higher slot it has been
+        // cascaded, so a timer filed there waits for the next round
+        int first = (wheel_clock & ((1ULL << shift) - 1)) ? 1 : 0;
+        for (int i = first; i < first + TIMER_WHEEL_SIZE; i++) {
+            if (wheel[level][(base + i) & WHEEL_MASK]) {
+                uint64_t at = (base + i) << shift;
+                if (at < next) {
+                    next = at;
+                }
+                break;
+            }
+        }
+    }
+    
+    return next;
+}
+
+void timer_setup(ktimer_t* timer, timer_func_t func, void* data) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->slot = NULL;
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+}
+
+void timer_add(ktimer_t* timer, uint64_t expires) {
+    uint64_t flags = irq_save();
+    timer->expires = expires;
+    
+    if (running) {
+        timer_list_add(&deferred, timer);
+        irq_restore(flags);
+        return;
+    }
+    
+    // An empty wheel can move its clock up freely, which keeps the first
+    // timer out of the higher levels
+    if (pending == 0) {
+        uint64_t now = timer_get_ms();
+        if (now > wheel_clock) {
+            wheel_clock = now;
+        }
+    }
+    
+    uint64_t at = wheel_insert(timer);
+    pending++;
+    
+    if (at < next_run) {
+        next_run = at;
+    }
+    timer_set_wakeup(at);
+    irq_restore(flags);
+}
+
+int timer_mod(ktimer_t* timer, uint64_t expires) {
+    int was_pending = timer_del(timer);
+    timer_add(timer, expires);
+    return was_pending;
+}
+
+int timer_del(ktimer_t* timer) {
+    uint64_t flags = irq_save();
+    if (!timer->slot) {
+        irq_restore(flags);
+        return 0;
+    }
+    
+    // next_run may now be early; timer_run finds nothing and moves it on
+    if (timer->slot != &deferred) {
+        pending--;
+    }
+    timer_list_remove(timer);
+    irq_restore(flags);
+    return 1;
+}
+
+int timer_pending(const ktimer_t* timer) {
+    return timer->slot != NULL;
+}
+
+// Helper: Keep a wakeup armed for next_run. The one armed may have been
+// used up by an earlier request from someone else in the meantime.
+static void wheel_arm(void) {
+    if (next_run != NO_TIMER) {
+        timer_set_wakeup(next_run);
+    }
+}
+
+void timer_run(void) {
+    uint64_t now = timer_get_ms();
+    if (next_run > now) {
+        wheel_arm();
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    running = 1;
+    
+    while (wheel_clock <= now) {
+        if (pending == 0) {
+            wheel_clock = now + 1;
+            break;
+        }
+        
+        uint32_t index = wheel_clock & WHEEL_MASK;
+        if (index == 0) {
+            for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                uint32_t slot = (wheel_clock >> (level * TIMER_WHEEL_BITS)) & WHEEL_MASK;
+                wheel_cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+        
+        // Nothing on level 0: skip ahead to the next cascade
+        if (level0_pending == 0) {
+            uint64_t boundary = (wheel_clock | WHEEL_MASK) + 1;
+            wheel_clock = (boundary < now + 1) ? boundary : now + 1;
+            continue;
+        }
+        
+        // Take the slot off the wheel first, so a callback deleting another
+        // timer in it cannot pull the list out from under the loop
+        ktimer_t* expired = NULL;
+        ktimer_t* timer;
+        while ((timer = wheel[0][index]) != NULL) {
+            timer_list_remove(timer);
+            timer_list_add(&expired, timer);
+        }
+        wheel_clock++;
+        
+        while ((timer = expired) != NULL) {
+            timer_list_remove(timer);
+            pending--;
+            fired++;
+            
+            irq_restore(flags);
+            timer->func(timer->data);
+            flags = irq_save();
+        }
+    }
+    
+    // File what the callbacks added now the clock is past them
+    running = 0;
+    ktimer_t* timer;
+    while ((timer = deferred) != NULL) {
+        timer_list_remove(timer);
+        wheel_insert(timer);
+        pending++;
+    }
+    
+    next_run = pending ? wheel_next_expiry() : NO_TIMER;
+    irq_restore(flags);
+    wheel_arm();
+}
+
+int timer_due(void) {
+    return next_run <= timer_get_ms();
+}
+
+void timer_wheel_get_info(timer_wheel_info_t* info) {
+    uint64_t flags = irq_save();
+    info->pending = pending;
+    info->fired = fired;
+    info->cascaded = cascaded;
+    irq_restore(flags);
+}
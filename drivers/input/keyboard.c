@@ -182,10 +182,8 @@ int keyboard_poll_event(keyboard_event_t* event) {
 
 // Check if any keys are available
 int keyboard_has_event(void) {
-    int ret;
-    __asm__ volatile("cli");
-    ret = (buffer_tail != buffer_head);
-    __asm__ volatile("sti");
-    return ret;
+    // A single comparison needs no critical section, and leaving the
+    // interrupt flag alone lets the idle loop check with interrupts off
+    return buffer_tail != buffer_head;
 }
 
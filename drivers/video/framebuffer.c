@@ -1,5 +1,8 @@
 #include <drivers/video/framebuffer.h>
 #include <multiboot/multiboot2.h>
+#include <mm/memlayout.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
 
 typedef volatile uint32_t vuint32_t;
 
@@ -39,7 +42,7 @@ void fb_init(struct framebuffer* out, void* multiboot_info)
             if (fb_tag->framebuffer_type != 1 || fb_tag->framebuffer_bpp != 32)
                 break;
 
-            out->addr   = (uintptr_t)fb_tag->framebuffer_addr;
+            out->addr   = (uintptr_t)phys_to_virt(fb_tag->framebuffer_addr);
             out->width  = fb_tag->framebuffer_width;
             out->height = fb_tag->framebuffer_height;
             out->pitch  = fb_tag->framebuffer_pitch;
@@ -111,6 +114,30 @@ void fb_fill_rect(struct framebuffer* fb,
     }
 }
 
+int fb_set_write_combining(struct framebuffer* fb, bool enable)
+{
+    if (!fb_initialized || !fb)
+        return -1;
+
+    // Retype the framebuffer's own direct map pages rather than adding a
+    // second mapping: aliases with different memory types are undefined
+    uint64_t phys = virt_to_phys((void*)fb->addr);
+    uint64_t start = phys & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = (phys + (uint64_t)fb->pitch * fb->height + PAGE_SIZE - 1)
+                   & ~(uint64_t)(PAGE_SIZE - 1);
+
+    uint64_t flags = PAGE_PRESENT | PAGE_WRITABLE;
+    if (enable)
+        flags |= PAGE_WRITE_COMBINING;
+
+    if (vmm_map_range((uint64_t)phys_to_virt(start), start, end - start, flags) != 0)
+        return -1;
+
+    // Nothing cached under the old type may be written back later
+    __asm__ volatile("wbinvd" ::: "memory");
+    return 0;
+}
+
 struct framebuffer* fb_get_current(void)
 {
     return current_fb;
@@ -154,10 +154,8 @@ vfs_node_t* tarfs_init(void* tar_data, size_t tar_size) {
         
         // Only process regular files and directories
         if (header->type == '0' || header->type == '\0' || header->type == '5') {
-            vfs_node_t* node = (vfs_node_t*)kmalloc(sizeof(vfs_node_t));
+            vfs_node_t* node = vfs_alloc_node();
             if (node) {
-                memset(node, 0, sizeof(vfs_node_t));
-                
                 // Copy name
                 strncpy(node->name, header->name, 255);
                 node->name[255] = '\0';
@@ -186,14 +184,16 @@ vfs_node_t* tarfs_init(void* tar_data, size_t tar_size) {
     }
     
     // Create root node
-    vfs_node_t* root = (vfs_node_t*)kmalloc(sizeof(vfs_node_t));
+    vfs_node_t* root = vfs_alloc_node();
     if (!root) {
+        for (uint32_t i = 0; i < file_idx; i++) {
+            vfs_free_node(fs_data->file_nodes[i]);
+        }
         kfree(fs_data->file_nodes);
         kfree(fs_data);
         return NULL;
     }
     
-    memset(root, 0, sizeof(vfs_node_t));
     strcpy(root->name, "/");
     root->type = VFS_DIRECTORY;
     root->size = 0;
@@ -1,5 +1,6 @@
 #include <fs/vfs.h>
 #include <mm/heap.h>
+#include <mm/slab.h>
 #include <lib/string/string.h>
 #include <ui/console.h>
 
@@ -7,22 +8,39 @@
 
 static vfs_node_t* vfs_root = NULL;
 static vfs_node_t* current_dir = NULL;
-static file_descriptor_t file_descriptors[MAX_FD];
+
+// Open descriptors point into fd_cache; NULL slots are free
+static file_descriptor_t* file_descriptors[MAX_FD];
+
+static kmem_cache_t* node_cache = NULL;
+static kmem_cache_t* fd_cache = NULL;
 
 void vfs_init(void) {
     // Initialize file descriptors
     for (int i = 0; i < MAX_FD; i++) {
-        file_descriptors[i].used = 0;
-        file_descriptors[i].node = NULL;
-        file_descriptors[i].position = 0;
-        file_descriptors[i].flags = 0;
+        file_descriptors[i] = NULL;
     }
     
+    node_cache = kmem_cache_create("vfs_node", sizeof(vfs_node_t), 0, NULL);
+    fd_cache = kmem_cache_create("file_descriptor", sizeof(file_descriptor_t), 0, NULL);
+    
     console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
     console_write("[VFS] Virtual File System initialized\n");
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
 }
 
+vfs_node_t* vfs_alloc_node(void) {
+    vfs_node_t* node = kmem_cache_alloc(node_cache);
+    if (node) {
+        memset(node, 0, sizeof(vfs_node_t));
+    }
+    return node;
+}
+
+void vfs_free_node(vfs_node_t* node) {
+    kmem_cache_free(node_cache, node);
+}
+
 void vfs_mount_root(vfs_node_t* root) {
     vfs_root = root;
     current_dir = root;
@@ -127,7 +145,7 @@ int vfs_open(const char* path, uint32_t flags) {
     // Find free file descriptor
     int fd = -1;
     for (int i = 0; i < MAX_FD; i++) {
-        if (!file_descriptors[i].used) {
+        if (!file_descriptors[i]) {
             fd = i;
             break;
         }
@@ -135,31 +153,34 @@ int vfs_open(const char* path, uint32_t flags) {
     
     if (fd == -1) return -1;  // No free descriptors
     
+    file_descriptor_t* desc = kmem_cache_alloc(fd_cache);
+    if (!desc) return -1;
+    
     // Initialize file descriptor
-    file_descriptors[fd].node = node;
-    file_descriptors[fd].position = 0;
-    file_descriptors[fd].flags = flags;
-    file_descriptors[fd].used = 1;
+    desc->node = node;
+    desc->position = 0;
+    desc->flags = flags;
+    file_descriptors[fd] = desc;
     
     return fd;
 }
 
 int vfs_close(int fd) {
-    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd].used) {
+    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd]) {
         return -1;
     }
     
-    file_descriptors[fd].used = 0;
-    file_descriptors[fd].node = NULL;
+    kmem_cache_free(fd_cache, file_descriptors[fd]);
+    file_descriptors[fd] = NULL;
     return 0;
 }
 
 int vfs_read(int fd, void* buffer, size_t size) {
-    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd].used) {
+    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd]) {
         return -1;
     }
     
-    file_descriptor_t* desc = &file_descriptors[fd];
+    file_descriptor_t* desc = file_descriptors[fd];
     
     if (!desc->node || !desc->node->read) {
         return -1;
@@ -174,11 +195,11 @@ int vfs_read(int fd, void* buffer, size_t size) {
 }
 
 int vfs_write(int fd, const void* buffer, size_t size) {
-    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd].used) {
+    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd]) {
         return -1;
     }
     
-    file_descriptor_t* desc = &file_descriptors[fd];
+    file_descriptor_t* desc = file_descriptors[fd];
     
     if (!desc->node || !desc->node->write) {
         return -1;
@@ -193,11 +214,11 @@ int vfs_write(int fd, const void* buffer, size_t size) {
 }
 
 int vfs_seek(int fd, int offset, int whence) {
-    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd].used) {
+    if (fd < 0 || fd >= MAX_FD || !file_descriptors[fd]) {
         return -1;
     }
     
-    file_descriptor_t* desc = &file_descriptors[fd];
+    file_descriptor_t* desc = file_descriptors[fd];
     
     switch (whence) {
         case SEEK_SET:
@@ -0,0 +1,48 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdint.h>
+
+// Interrupt Vectors
+#define LAPIC_TIMER_VECTOR    48
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+// Register Offsets
+#define LAPIC_REG_TPR         0x080
+#define LAPIC_REG_EOI         0x0B0
+#define LAPIC_REG_SVR         0x0F0
+#define LAPIC_REG_LVT_TIMER   0x320
+#define LAPIC_REG_LVT_LINT0   0x350
+#define LAPIC_REG_LVT_LINT1   0x360
+#define LAPIC_REG_TIMER_INIT  0x380
+#define LAPIC_REG_TIMER_CUR   0x390
+#define LAPIC_REG_TIMER_DIV   0x3E0
+
+// Register Bits
+#define LAPIC_SVR_ENABLE       0x100
+#define LAPIC_LVT_MASKED       (1 << 16)
+#define LAPIC_LVT_TSC_DEADLINE (2 << 17)
+#define LAPIC_LVT_EXTINT       0x700
+#define LAPIC_LVT_NMI          0x400
+#define LAPIC_TIMER_DIV16      0x3
+
+// MSRs
+#define MSR_APIC_BASE         0x1B
+#define MSR_TSC_DEADLINE      0x6E0
+#define APIC_BASE_ENABLE      (1 << 11)
+
+// Function Declarations
+int lapic_init(void);                       // 0 once the local APIC is enabled
+void lapic_eoi(void);
+int lapic_has_tsc_deadline(void);
+
+// Timer: one-shot countdown (bus clock / 16) or TSC deadline, both firing
+// LAPIC_TIMER_VECTOR once. lapic_timer_free_run counts down from the top
+// with the interrupt masked, for calibration.
+void lapic_timer_oneshot(uint32_t count);
+void lapic_timer_deadline(uint64_t tsc);
+void lapic_timer_free_run(void);
+uint32_t lapic_timer_current(void);
+void lapic_timer_stop(void);
+
+#endif // LAPIC_H
@@ -26,13 +26,14 @@
 #define PIT_TICKS_PER_SEC 1000
 
 // Global Variables
-extern volatile uint32_t pit_ticks;
+extern volatile uint64_t pit_ticks;
 
 // Function Declarations
 void pit_init(uint32_t frequency);
 void pit_sleep(uint32_t ms);
-uint32_t pit_get_ticks(void);
+uint64_t pit_get_ticks(void);
 void pit_set_frequency(uint32_t frequency);
+void pit_stop(void);                    // Local APIC timer took over (see timer.h)
 void pit_handler(void);
 
 #endif // PIT_H
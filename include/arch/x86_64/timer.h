@@ -0,0 +1,37 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// System timer. The clock runs off the TSC, calibrated against the PIT at
+// boot, wherever the TSC rate is stable. With a local APIC on top the
+// APIC timer is one-shot, programmed only for the next wakeup someone
+// asked for, so an idle CPU stays halted (tickless). Otherwise the PIT
+// keeps ticking at PIT_TICKS_PER_SEC and wakeups come for free.
+
+#define TIMER_CALIBRATE_MS 50       // PIT ticks the TSC and APIC timer are timed over
+#define TIMER_MAX_ARM_MS   60000    // Longest single APIC timer shot
+
+// Function Declarations
+void timer_init(void);
+int timer_is_tickless(void);
+
+// Nanoseconds since boot, monotonic and 64-bit. Reads the TSC (or the
+// PIT tick count, in 1 ms steps, without a stable TSC): no port I/O, so
+// it is cheap enough for benchmarks and tracing.
+uint64_t clock_monotonic_ns(void);
+
+// Milliseconds since boot
+uint64_t timer_get_ms(void);
+
+// Make sure the CPU wakes up by ms (the earliest pending request wins)
+void timer_set_wakeup(uint64_t ms);
+
+// Halt until the next interrupt. Call with interrupts disabled, after the
+// last check for work: they are enabled again atomically with the halt.
+void timer_idle(void);
+
+void timer_sleep_ms(uint32_t ms);
+void timer_handler(void);
+
+#endif // TIMER_H
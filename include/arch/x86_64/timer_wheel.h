@@ -0,0 +1,57 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Kernel timers: callbacks that run once the clock (timer_get_ms) reaches
+// their expiry. They sit in a hierarchical timer wheel, so adding and
+// removing one is O(1). Callbacks run from timer_run, the bottom half of
+// the timer interrupt, with interrupts enabled; they may re-add themselves.
+
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SIZE   (1 << TIMER_WHEEL_BITS)  // Slots per level
+#define TIMER_WHEEL_LEVELS 4                        // 1 ms slots up to ~4.6 h out
+
+typedef void (*timer_func_t)(void* data);
+
+typedef struct ktimer {
+    struct ktimer* next;
+    struct ktimer* prev;
+    struct ktimer** slot;   // List the timer is on, NULL when not pending
+    uint64_t expires;       // timer_get_ms() value to fire at
+    timer_func_t func;
+    void* data;
+} ktimer_t;
+
+// Wheel statistics
+typedef struct {
+    uint32_t pending;
+    uint64_t fired;
+    uint64_t cascaded;      // Timers moved down a level on the way
+} timer_wheel_info_t;
+
+// Prepare a timer before its first use
+void timer_setup(ktimer_t* timer, timer_func_t func, void* data);
+
+// Arm a timer that is not pending to fire at expires (ms since boot)
+void timer_add(ktimer_t* timer, uint64_t expires);
+
+// Arm a timer, moving it if it is pending already (returns 1 if it was)
+int timer_mod(ktimer_t* timer, uint64_t expires);
+
+// Disarm a timer (returns 1 if it was pending)
+int timer_del(ktimer_t* timer);
+
+int timer_pending(const ktimer_t* timer);
+
+// Run expired timers and arm the wakeup for the next one (main loop)
+void timer_run(void);
+
+// Whether timer_run has work right now. Checked with interrupts disabled
+// before halting, as the wakeup may already have fired.
+int timer_due(void);
+
+void timer_wheel_get_info(timer_wheel_info_t* info);
+
+#endif // TIMER_WHEEL_H
@@ -32,6 +32,10 @@ void fb_fill_rect(struct framebuffer* fb,
                   uint32_t w, uint32_t h,
                   uint8_t r, uint8_t g, uint8_t b);
 
+// Map the framebuffer write-combining (or back to the default memory type)
+// so pixel stores merge into bursts. Needs the VMM; returns 0 on success.
+int fb_set_write_combining(struct framebuffer* fb, bool enable);
+
 struct framebuffer* fb_get_current(void);
 bool fb_is_initialized(void);
 
@@ -1,8 +1,9 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include <mm/memlayout.h>
 
-#define VGA_BUFFER ((uint16_t*)0xB8000)
+#define VGA_BUFFER ((uint16_t*)phys_to_virt(0xB8000))
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 
@@ -40,12 +40,15 @@ typedef struct {
     vfs_node_t* node;
     uint32_t position;
     uint32_t flags;
-    int used;
 } file_descriptor_t;
 
 // Initialize VFS
 void vfs_init(void);
 
+// Allocate a zeroed node / free it (for filesystem drivers)
+vfs_node_t* vfs_alloc_node(void);
+void vfs_free_node(vfs_node_t* node);
+
 // Mount root filesystem
 void vfs_mount_root(vfs_node_t* root);
 
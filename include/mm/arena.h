@@ -0,0 +1,23 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bump allocator over PMM pages for short-lived allocations that all die
+// together: there is no per-object free, arena_reset releases everything
+typedef struct arena arena_t;
+
+// Create an arena that grabs chunk_pages pages at a time (0 = 1 page)
+arena_t* arena_create(size_t chunk_pages);
+
+// Allocate size bytes, 16-byte aligned (NULL when out of memory)
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Drop every allocation, keeping only the first chunk for reuse
+void arena_reset(arena_t* arena);
+
+// Release the arena and all its pages
+void arena_destroy(arena_t* arena);
+
+#endif // ARENA_H
@@ -4,13 +4,27 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Initialize kernel heap
-void heap_init(void* start, size_t size);
+// Heap growth and trimming (bytes)
+#define HEAP_INITIAL_SIZE   (1024 * 1024)
+#define HEAP_GROW_MIN       (64 * 1024)
+#define HEAP_TRIM_THRESHOLD (1024 * 1024)   // Free space at the top before trimming
+#define HEAP_TRIM_KEEP      (256 * 1024)    // Free space left at the top after it
+
+// Initialize kernel heap (call after vmm_init)
+void heap_init(void);
+
+// Tune when free pages at the top of the heap go back to the PMM
+void heap_set_trim(size_t threshold, size_t keep);
 
 // Allocate memory
 void* kmalloc(size_t size);
+
+// Allocate with the payload aligned to alignment (a power of two); the
+// result is freed with kfree, and krealloc may move it off the alignment
 void* kmalloc_aligned(size_t size, size_t alignment);
 void* kcalloc(size_t nmemb, size_t size);
+
+// Resize in place when the next block is free (or at the heap top), else move
 void* krealloc(void* ptr, size_t size);
 
 // Free memory
@@ -19,6 +33,30 @@ void kfree(void* ptr);
 // Get heap statistics
 size_t heap_get_used(void);
 size_t heap_get_free(void);
+size_t heap_get_peak(void);             // Highest heap_get_used() so far
+size_t heap_get_largest_free(void);
+uint32_t heap_get_fragmentation(void);  // Percent of free space outside the largest block
+
+// Allocation profiling: blocks allocated while enabled are tagged with
+// their caller, and every tag keeps counts, live/peak bytes and a size
+// histogram. Tag 0 (caller 0) collects callers once the table is full.
+#define HEAP_PROFILE_TAGS 64
+#define HEAP_HIST_BUCKETS 8     // Up to 32, 128, 512, 2K, 8K, 32K, 128K bytes, larger
+
+typedef struct {
+    uintptr_t caller;       // Return address of the kmalloc call
+    uint64_t allocs;
+    uint64_t frees;
+    size_t live_bytes;
+    size_t peak_bytes;
+    uint64_t histogram[HEAP_HIST_BUCKETS];
+} heap_tag_info_t;
+
+void heap_profile_enable(int enable);
+int heap_profile_enabled(void);
+
+// Describe tag index (returns -1 past the last one)
+int heap_get_tag_info(int index, heap_tag_info_t* info);
 
 
 void heap_debug_info(void);
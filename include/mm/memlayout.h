@@ -0,0 +1,36 @@
+#ifndef MEMLAYOUT_H
+#define MEMLAYOUT_H
+
+#include <stdint.h>
+
+// Kernel virtual address space layout
+//
+//   0xFFFF800000000000  Direct map: all physical memory at phys + DIRECT_MAP_BASE
+//   0xFFFFC00000000000  Kernel heap, mapped page by page on demand
+//   0xFFFFD00000000000  vmalloc: virtually contiguous, page by page backed
+//   0xFFFFFFFF80000000  Kernel image (-mcmodel=kernel), physical 0 + 1 MiB
+//
+// The lower half is left unmapped once the VMM is up.
+#define DIRECT_MAP_BASE   0xFFFF800000000000ULL
+#define KERNEL_HEAP_BASE  0xFFFFC00000000000ULL
+#define KERNEL_HEAP_LIMIT 0xFFFFC01000000000ULL  // 64 GiB
+#define VMALLOC_BASE      0xFFFFD00000000000ULL
+#define VMALLOC_LIMIT     0xFFFFD01000000000ULL  // 64 GiB
+#define KERNEL_VIRT_BASE  0xFFFFFFFF80000000ULL
+
+// Physical address as seen through the direct map
+static inline void* phys_to_virt(uint64_t phys) {
+    return (void*)(phys + DIRECT_MAP_BASE);
+}
+
+// Physical address of a direct map or kernel image pointer (anything
+// else, like heap memory, needs vmm_get_physical_address)
+static inline uint64_t virt_to_phys(const void* virt) {
+    uint64_t addr = (uint64_t)virt;
+    if (addr >= KERNEL_VIRT_BASE) {
+        return addr - KERNEL_VIRT_BASE;
+    }
+    return addr - DIRECT_MAP_BASE;
+}
+
+#endif // MEMLAYOUT_H
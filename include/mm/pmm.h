@@ -5,10 +5,77 @@
 #include <stddef.h>
 
 #define PAGE_SIZE 4096
-#define PAGES_PER_BLOCK 32  // 32 pages per bitmap block (32 bits)
+#define PAGES_PER_BLOCK 64  // 64 pages per bitmap block (64 bits)
 
-// Initialize physical memory manager
-void pmm_init(uint64_t mem_size);
+// Buddy allocator: largest block is 2^PMM_MAX_ORDER pages (1 GiB)
+#define PMM_MAX_ORDER 18
+
+// RAM below this is direct mapped by boot.asm and usable straight away
+#define PMM_BOOT_MAP_LIMIT 0x100000000ULL
+
+// Memory zones, lowest first. An allocation for a zone may fall back to
+// the zones below it, never above.
+#define ZONE_DMA        0       // Below 16 MB, legacy ISA DMA
+#define ZONE_DMA32      1       // Below 4 GiB, 32-bit DMA
+#define ZONE_NORMAL     2       // Everything else
+#define PMM_ZONES       3
+
+#define ZONE_DMA_LIMIT   0x1000000ULL
+#define ZONE_DMA32_LIMIT 0x100000000ULL
+
+// Page frame types (struct page flags), exactly one is set per page
+#define PG_FREE       (1 << 0)  // Owned by the buddy allocator
+#define PG_KERNEL     (1 << 1)  // General kernel allocation or PMM metadata
+#define PG_PAGETABLE  (1 << 2)  // Paging structure
+#define PG_HEAP       (1 << 3)  // Backs the kernel heap
+#define PG_FILE       (1 << 4)  // File data
+#define PG_SLAB       (1 << 5)  // Slab of a kmem_cache
+#define PG_TYPE_MASK  0x3F
+#define PG_TYPES      6
+
+// Page frame state flags
+#define PG_BUDDY      (1 << 8)  // First page of a free buddy block
+#define PG_MOVABLE    (1 << 9)  // Owner can move it (see pmm_set_migrate_handler)
+
+// Per-page metadata, one entry for every page frame the PMM manages
+struct page {
+    uint32_t refcount;      // Users of the page; 0 when free
+    uint16_t flags;         // PG_* type and state
+    uint8_t order;          // Buddy order of the free block (PG_BUDDY) or allocation
+    uint8_t zone;           // Memory zone the frame belongs to
+};
+
+// Pre-zeroed page pool, refilled from the idle loop
+#define PMM_ZERO_POOL_PAGES 256
+#define PMM_ZERO_BATCH      4   // Pages zeroed per pmm_idle_zero() call
+
+typedef struct {
+    uint64_t pages;         // Zeroed pages waiting in the pool
+    uint64_t hits;          // pmm_alloc_zeroed_page() served from the pool
+    uint64_t misses;        // ... zeroed on the spot instead
+} pmm_zero_pool_info_t;
+
+// Called after a PG_MOVABLE page was copied from old_phys to new_phys;
+// the owner repoints its mappings and returns 0, or -1 to keep the page
+typedef int (*pmm_migrate_fn)(uint64_t old_phys, uint64_t new_phys);
+
+// Zone statistics (pages)
+typedef struct {
+    const char* name;
+    uint64_t total_pages;
+    uint64_t free_pages;
+    uint64_t low_pages;     // Fallback allocations from higher zones stop here
+    uint64_t high_pages;    // Below this the zone is under pressure
+} pmm_zone_info_t;
+
+// Initialize physical memory manager from the Multiboot2 memory map
+void pmm_init(void* multiboot_info);
+
+// Bring regions above PMM_BOOT_MAP_LIMIT online once they are mapped
+void pmm_online_regions(void);
+
+// Describe usable region index (returns -1 past the last one)
+int pmm_get_region(int index, uint64_t* base, uint64_t* length);
 
 // Allocate/free physical pages
 uint64_t pmm_alloc_page(void);
@@ -18,9 +85,52 @@ void pmm_free_page(uint64_t page_addr);
 uint64_t pmm_alloc_pages(size_t count);
 void pmm_free_pages(uint64_t page_addr, size_t count);
 
+// Allocate pages tagged with a PG_* type (pmm_alloc_pages uses PG_KERNEL)
+uint64_t pmm_alloc_pages_type(size_t count, uint32_t type);
+
+// Allocate pages aligned to align bytes (a power of two, at least a page),
+// compacting movable pages if no aligned run is free
+uint64_t pmm_alloc_pages_aligned(size_t count, size_t align);
+uint64_t pmm_alloc_pages_aligned_type(size_t count, size_t align, uint32_t type);
+
+// Allocate pages from zone or, above its low watermark, a zone below it
+// (pmm_alloc_pages_type uses ZONE_NORMAL, so high memory goes first)
+uint64_t pmm_alloc_pages_zone(size_t count, int zone, uint32_t type);
+
+// Page frame database lookups (NULL/0 for frames the PMM does not manage)
+struct page* pmm_get_page(uint64_t page_addr);
+uint64_t pmm_page_to_phys(struct page* page);
+
+// Register the migrate handler for PG_MOVABLE pages of a PG_* type
+void pmm_set_migrate_handler(uint32_t type, pmm_migrate_fn handler);
+
+// Migrate movable pages until a free block of 2^order pages exists
+// (returns 0 on success, -1 if no window could be emptied)
+int pmm_compact(uint32_t order);
+
+// Allocate one zeroed page, straight from the pool when it has one
+uint64_t pmm_alloc_zeroed_page(void);
+uint64_t pmm_alloc_zeroed_page_type(uint32_t type);
+
+// Top up the zeroed page pool a few pages at a time (call when idle).
+// Returns 1 while there is more to do, 0 once the pool is full or no
+// page can be spared.
+int pmm_idle_zero(void);
+
+// Take another reference on an allocated page; pmm_free_page drops one
+// and only returns the page once the last reference is gone
+void pmm_page_ref(uint64_t page_addr);
+
 // Get memory statistics
 uint64_t pmm_get_total_memory(void);
 uint64_t pmm_get_used_memory(void);
 uint64_t pmm_get_free_memory(void);
+uint64_t pmm_get_largest_free_block(void);
+uint64_t pmm_get_type_memory(uint32_t type);
+
+// Describe zone (returns -1 for an unknown zone)
+int pmm_get_zone_info(int zone, pmm_zone_info_t* info);
+
+void pmm_get_zero_pool_info(pmm_zero_pool_info_t* info);
 
 #endif // PMM_H
@@ -0,0 +1,37 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SLAB_NAME_LEN 24
+
+// Cache of equally sized objects carved out of PMM pages
+typedef struct kmem_cache kmem_cache_t;
+
+// Cache statistics
+typedef struct {
+    const char* name;
+    size_t object_size;     // Size asked for at creation
+    size_t stride;          // Bytes per object in a slab, padding included
+    uint32_t slab_pages;
+    uint32_t objects_per_slab;
+    uint32_t slabs;
+    uint64_t active_objects;
+    uint64_t allocs;
+    uint64_t frees;
+} kmem_cache_info_t;
+
+// Create a cache (align 0 = 8 bytes). ctor runs once per object when its
+// slab is created; objects must be freed back in their constructed state.
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align,
+                                void (*ctor)(void* obj));
+
+// Allocate/free one object
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Describe cache index (returns -1 past the last one)
+int kmem_cache_get_info(int index, kmem_cache_info_t* info);
+
+#endif // SLAB_H
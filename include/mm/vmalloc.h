@@ -0,0 +1,29 @@
+#ifndef VMALLOC_H
+#define VMALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VMALLOC_AREAS 64        // Live vmalloc allocations at once
+
+// Usage statistics
+typedef struct {
+    uint32_t areas;
+    uint64_t reserved_bytes;    // Virtual space handed out, guard pages excluded
+    uint64_t mapped_bytes;      // ... of it backed by pages right now
+} vmalloc_info_t;
+
+// Allocate size bytes that are contiguous in virtual memory only, mapped
+// page by page from wherever the PMM has frames. For large buffers that
+// need not be physically contiguous. Page aligned, NULL when out of memory.
+void* vmalloc(size_t size);
+
+// Like vmalloc, but pages are zero-filled on first touch instead of up front
+void* vmalloc_lazy(size_t size);
+
+// Unmap and free a vmalloc/vmalloc_lazy allocation
+void vfree(void* ptr);
+
+void vmalloc_get_info(vmalloc_info_t* info);
+
+#endif // VMALLOC_H
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <mm/memlayout.h>
 
 // Page table flags
 #define PAGE_PRESENT    (1 << 0)
@@ -10,6 +11,44 @@
 #define PAGE_USER       (1 << 2)
 #define PAGE_WRITETHROUGH (1 << 3)
 #define PAGE_CACHE_DISABLE (1 << 4)
+#define PAGE_HUGE       (1 << 7)
+#define PAGE_PAT        (1 << 7)    // PAT bit of a 4 KiB entry
+#define PAGE_GLOBAL     (1 << 8)
+#define PAGE_PAT_LARGE  (1 << 12)   // PAT bit of a 2 MiB/1 GiB entry
+
+// Software flag for vmm_map_page/vmm_map_range: map write-combining. The
+// VMM turns it into the PAT bits it set up for that (ignored without PAT).
+#define PAGE_WRITE_COMBINING (1 << 9)
+
+#define LARGE_PAGE_SIZE 0x200000  // 2 MiB
+#define HUGE_PAGE_SIZE  0x40000000  // 1 GiB
+
+// Batched invalidation: beyond this many pages one CR3 reload is cheaper
+// than a run of invlpg (the threshold is tunable up to VMM_BATCH_MAX)
+#define VMM_FLUSH_THRESHOLD 32
+#define VMM_BATCH_MAX       64
+
+// TLB tagging (vmm_set_tlb_features)
+#define VMM_TLB_GLOBAL  (1 << 0)  // Kernel pages survive CR3 loads (CR4.PGE)
+#define VMM_TLB_PCID    (1 << 1)  // Address spaces keep their entries (CR4.PCIDE)
+
+#define VMM_PCIDS 32              // Address spaces holding a PCID at once
+
+#define VMM_LAZY_REGIONS 16
+
+// Page fault error code bits
+#define PF_ERR_PRESENT  (1 << 0)  // Protection violation, not a missing page
+#define PF_ERR_WRITE    (1 << 1)
+#define PF_ERR_USER     (1 << 2)
+#define PF_ERR_RESERVED (1 << 3)  // Reserved bit set in a paging entry
+#define PF_ERR_FETCH    (1 << 4)
+
+// TLB flush statistics
+typedef struct {
+    uint64_t page_flushes;  // invlpg issued
+    uint64_t full_flushes;  // CR3 reloads in place of invlpg runs
+    uint64_t skipped;       // Entries that were not present, nothing to flush
+} vmm_flush_info_t;
 
 // Page directory/table structure
 typedef struct {
@@ -19,16 +58,56 @@ typedef struct {
 // Initialize virtual memory manager
 void vmm_init(void);
 
-// Map virtual address to physical address
+// Map virtual address to physical address (splits a large page over it)
 int vmm_map_page(uint64_t virt_addr, uint64_t phys_addr, uint64_t flags);
 
+// Map length bytes (page aligned) with 1 GiB and 2 MiB pages wherever
+// virt and phys alignment allow, 4 KiB pages elsewhere
+int vmm_map_range(uint64_t virt_addr, uint64_t phys_addr, uint64_t length, uint64_t flags);
+
 // Unmap virtual address
 void vmm_unmap_page(uint64_t virt_addr);
 
+// Unmap a range, splitting large pages it only partly covers
+void vmm_unmap_range(uint64_t virt_addr, uint64_t length);
+
+// Batch TLB invalidation (nestable): mappings changed in between are
+// flushed once at vmm_batch_end instead of page by page
+void vmm_batch_begin(void);
+void vmm_batch_end(void);
+void vmm_set_flush_threshold(uint32_t pages);
+void vmm_get_flush_info(vmm_flush_info_t* info);
+
+// Register a demand-zero region: the first touch of each unmapped page in
+// it maps a zeroed PMM page of the given PG_* type with flags. Removing a
+// region leaves the pages already faulted in to its owner.
+int vmm_add_lazy_region(uint64_t start, uint64_t length, uint64_t flags, uint32_t type);
+void vmm_remove_lazy_region(uint64_t start);
+
+// Move the end of a region, e.g. to follow a break; faults past it are
+// fatal again (pages already mapped there stay)
+int vmm_resize_lazy_region(uint64_t start, uint64_t length);
+
+// Resolve a page fault in a lazy region (returns 0 if handled, -1 if not)
+int vmm_handle_page_fault(uint64_t fault_addr, uint64_t err_code);
+uint64_t vmm_get_demand_faults(void);
+
 // Get physical address from virtual address
 uint64_t vmm_get_physical_address(uint64_t virt_addr);
 
-// Switch page directory
+// Switch page directory (pml4 is a direct map pointer). With PCIDs the
+// entries of a recently used address space are kept across the switch.
 void vmm_switch_page_directory(page_table_t* pml4);
 
+// Create/destroy an address space sharing the kernel half. Kernel PML4
+// entries are copied on creation, so kernel regions must exist by then.
+page_table_t* vmm_create_address_space(void);
+void vmm_destroy_address_space(page_table_t* pml4);
+page_table_t* vmm_get_kernel_pml4(void);
+
+// Turn VMM_TLB_* features on or off, as far as the CPU supports them
+// (PCID implies global pages, and needs PGE). Returns the features now enabled.
+uint32_t vmm_set_tlb_features(uint32_t features);
+uint32_t vmm_get_tlb_features(void);
+
 #endif // VMM_H
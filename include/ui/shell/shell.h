@@ -6,6 +6,9 @@
 
 #define SHELL_BUFFER_SIZE 256
 #define SHELL_HISTORY_SIZE 10
+#define SHELL_SCRATCH_PAGES 4   // Scratch arena chunk size
+
+typedef struct arena arena_t;
 
 void shell_init(void);
 void shell_handle_char(char c);
@@ -14,4 +17,7 @@ void shell_print_prompt(void);
 void shell_update(void);
 void shell_draw(void);
 
+// Scratch memory for the running command, reset when it returns
+arena_t* shell_scratch(void);
+
 #endif // SHELL_H
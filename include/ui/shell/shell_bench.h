@@ -0,0 +1,9 @@
+#ifndef SHELL_BENCH_H
+#define SHELL_BENCH_H
+
+#include <stdint.h>
+
+// Run an in-kernel benchmark by name ("bench" with no name lists them)
+void cmd_bench(const char* args);
+
+#endif // SHELL_BENCH_H
@@ -17,6 +17,8 @@ void cmd_miko(void);
 void cmd_snake(void);
 void cmd_tetris(void);
 void cmd_meminfo(void);
+void cmd_slabinfo(void);
+void cmd_heapstat(const char* args);
 
 
 void cmd_ls(const char* args);
@@ -4,7 +4,6 @@
 #include <stdint.h>
 
 void snake_init(void);
-void snake_update(void);
 void snake_draw(void);
 void snake_input(char c);
 void snake_special_input(uint8_t scancode);
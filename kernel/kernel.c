@@ -4,6 +4,8 @@
 #include <arch/x86_64/idt.h>
 #include <arch/x86_64/pit.h>
 #include <arch/x86_64/pic.h>
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/timer_wheel.h>
 #include <drivers/input/keyboard.h>
 #include <ui/shell/shell.h>
 #include <ui/tty/tty.h>
@@ -15,26 +17,6 @@
 
 extern tty_t ttys[MAX_TTYS];
 
-// Reserve memory for kernel heap
-static uint8_t kernel_heap[16 * 1024 * 1024] __attribute__((aligned(4096)));
-
-// Get total RAM from multiboot
-static uint64_t get_memory_size(void* multiboot_info) {
-    uint8_t* mb = multiboot_info;
-    struct multiboot_tag* tag = (void*)(mb + 8);
-    
-    while (tag->type != MULTIBOOT_TAG_TYPE_END) {
-        if (tag->type == MULTIBOOT_TAG_TYPE_BASIC_MEMINFO) {
-            struct multiboot_tag_basic_meminfo* meminfo = 
-                (struct multiboot_tag_basic_meminfo*)tag;
-            return (uint64_t)(meminfo->mem_upper + 1024) * 1024;
-        }
-        tag = (void*)((uint8_t*)tag + ((tag->size + 7) & ~7));
-    }
-    
-    return 128 * 1024 * 1024;
-}
-
 // Get initrd module from multiboot
 static void* get_initrd(void* multiboot_info, size_t* size) {
     uint8_t* mb = multiboot_info;
@@ -44,7 +26,7 @@ static void* get_initrd(void* multiboot_info, size_t* size) {
         if (tag->type == MULTIBOOT_TAG_TYPE_MODULE) {
             struct multiboot_tag_module* mod = (struct multiboot_tag_module*)tag;
             *size = mod->mod_end - mod->mod_start;
-            return (void*)(uint64_t)mod->mod_start;
+            return phys_to_virt(mod->mod_start);
         }
         tag = (void*)((uint8_t*)tag + ((tag->size + 7) & ~7));
     }
@@ -52,8 +34,9 @@ static void* get_initrd(void* multiboot_info, size_t* size) {
     return NULL;
 }
 
-void kernel_main(void* multiboot_info) {
+void kernel_main(uint64_t multiboot_phys) {
     struct framebuffer fb;
+    void* multiboot_info = phys_to_virt(multiboot_phys);
     
     // Initialize framebuffer
     fb_init(&fb, multiboot_info);
@@ -94,10 +77,13 @@ void kernel_main(void* multiboot_info) {
     keyboard_init();
     
     // Initialize memory management
-    uint64_t total_mem = get_memory_size(multiboot_info);
-    pmm_init(total_mem);
+    pmm_init(multiboot_info);
     vmm_init();
-    heap_init(kernel_heap, sizeof(kernel_heap));
+    heap_init();
+    fb_set_write_combining(&fb, true);
+    
+    // Local APIC timer: needs the VMM to map its registers
+    timer_init();
     
     // Initialize filesystem
     vfs_init();
@@ -129,6 +115,9 @@ void kernel_main(void* multiboot_info) {
     while (1) {
         tty_poll_input();
         
+        // Bottom half of the timer interrupt: expired kernel timers
+        timer_run();
+        
         int current = tty_get_current();
         
         for (int i = 0; i < MAX_TTYS; i++) {
@@ -146,6 +135,21 @@ void kernel_main(void* multiboot_info) {
             }
         }
         
-        asm volatile ("hlt");
+        // Without a periodic tick wakeups are rare, so top up the zeroed
+        // pool in batches until it is full or there is work again
+        while (pmm_idle_zero()) {
+            if (keyboard_has_event() || timer_due()) {
+                break;
+            }
+        }
+        
+        // Sleep until the next interrupt, unless input came in or a timer
+        // expired meanwhile
+        asm volatile ("cli");
+        if (keyboard_has_event() || timer_due()) {
+            asm volatile ("sti");
+        } else {
+            timer_idle();
+        }
     }
 }
@@ -0,0 +1,119 @@
+#include <mm/arena.h>
+#include <mm/pmm.h>
+#include <mm/memlayout.h>
+
+#define ARENA_ALIGN 16
+
+// Chunks are runs of PMM pages with this header at the start. The first
+// chunk also holds the arena itself, so an arena costs no heap memory.
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t pages;
+} arena_chunk_t;
+
+struct arena {
+    arena_chunk_t* first;
+    arena_chunk_t* current;
+    uint8_t* ptr;           // Next free byte in current
+    uint8_t* end;
+    size_t chunk_pages;
+};
+
+// Helper: Round up to ARENA_ALIGN
+static inline size_t arena_align(size_t value) {
+    return (value + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+#define CHUNK_HEADER_SIZE arena_align(sizeof(arena_chunk_t))
+#define ARENA_HEADER_SIZE arena_align(sizeof(struct arena))
+
+static arena_chunk_t* chunk_alloc(size_t pages) {
+    uint64_t phys = pmm_alloc_pages_type(pages, PG_KERNEL);
+    if (!phys) {
+        return NULL;
+    }
+    
+    arena_chunk_t* chunk = (arena_chunk_t*)phys_to_virt(phys);
+    chunk->next = NULL;
+    chunk->pages = pages;
+    return chunk;
+}
+
+// Helper: Chain a chunk with room for size bytes after the current one
+static int arena_grow(arena_t* arena, size_t size) {
+    size_t pages = (CHUNK_HEADER_SIZE + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages < arena->chunk_pages) {
+        pages = arena->chunk_pages;
+    }
+    
+    arena_chunk_t* chunk = chunk_alloc(pages);
+    if (!chunk) {
+        return -1;
+    }
+    
+    arena->current->next = chunk;
+    arena->current = chunk;
+    arena->ptr = (uint8_t*)chunk + CHUNK_HEADER_SIZE;
+    arena->end = (uint8_t*)chunk + pages * PAGE_SIZE;
+    return 0;
+}
+
+arena_t* arena_create(size_t chunk_pages) {
+    if (chunk_pages == 0) {
+        chunk_pages = 1;
+    }
+    
+    arena_chunk_t* chunk = chunk_alloc(chunk_pages);
+    if (!chunk) {
+        return NULL;
+    }
+    
+    arena_t* arena = (arena_t*)((uint8_t*)chunk + CHUNK_HEADER_SIZE);
+    arena->first = chunk;
+    arena->chunk_pages = chunk_pages;
+    arena_reset(arena);
+    return arena;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    if (!arena || size == 0) {
+        return NULL;
+    }
+    
+    size = arena_align(size);
+    if (size > (size_t)(arena->end - arena->ptr) && arena_grow(arena, size) != 0) {
+        return NULL;
+    }
+    
+    void* ptr = arena->ptr;
+    arena->ptr += size;
+    return ptr;
+}
+
+void arena_reset(arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    arena_chunk_t* chunk = arena->first->next;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        pmm_free_pages(virt_to_phys(chunk), chunk->pages);
+        chunk = next;
+    }
+    
+    arena->first->next = NULL;
+    arena->current = arena->first;
+    arena->ptr = (uint8_t*)arena->first + CHUNK_HEADER_SIZE + ARENA_HEADER_SIZE;
+    arena->end = (uint8_t*)arena->first + arena->first->pages * PAGE_SIZE;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    arena_reset(arena);
+    arena_chunk_t* first = arena->first;
+    pmm_free_pages(virt_to_phys(first), first->pages);
+}
@@ -1,36 +1,162 @@
 #include <mm/heap.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
 #include <ui/console.h>
 
 // Memory block header
+// Blocks tile the heap back to back, so a block's physical neighbour starts
+// right after its payload. Free blocks also sit on the free list of their
+// size class, linked through the start of their payload, and repeat their
+// size in a footer (last word of the payload). With prev_free that lets
+// kfree find and merge both neighbours in constant time.
+//
+// The heap lives at KERNEL_HEAP_BASE in a demand-zero region: growing only
+// moves the top, and PMM pages are mapped as the heap first touches them.
+// A zero-sized epilogue header marks the top; growing turns it into the
+// header of the new free space.
+//
+// Build with -DHEAP_DEBUG to verify the whole heap on every kmalloc/kfree.
 typedef struct block_header {
     size_t size;                    // Size of the block (excluding header)
-    struct block_header* next;      // Next block in free list
-    int is_free;                    // 1 if free, 0 if allocated
+    uint32_t is_free;               // 1 if free, 0 if allocated
+    uint16_t prev_free;             // 1 if the block before is free
+    uint16_t tag;                   // Profiling tag of the allocating caller
 } block_header_t;
 
+typedef struct free_links {
+    struct block_header* next;
+    struct block_header* prev;
+} free_links_t;
+
 #define BLOCK_HEADER_SIZE sizeof(block_header_t)
 #define ALIGN_SIZE 16
+#define MIN_BLOCK_SIZE 32           // Room for the free list links and footer
+
+// Size classes: class n holds free blocks of [2^n, 2^(n+1)) bytes
+#define HEAP_CLASSES 64
+
+#define HEAP_TAG_NONE 0xFFFF        // Allocated while profiling was off
 
 static uint8_t* heap_start = NULL;
-static uint8_t* heap_end = NULL;
-static block_header_t* free_list = NULL;
-static size_t total_size = 0;
+static uint8_t* heap_end = NULL;        // Epilogue header (heap ends after it)
+static block_header_t* free_lists[HEAP_CLASSES];
+static uint64_t nonempty_classes = 0;   // Bit n set when free_lists[n] is non-empty
+static size_t total_size = 0;           // Mapped bytes
 static size_t used_size = 0;
+static size_t peak_size = 0;
+
+// Profiling tags, hashed by caller address. Tag 0 takes every caller
+// that finds the table full.
+static heap_tag_info_t tags[HEAP_PROFILE_TAGS];
+static int profiling = 0;
+
+static size_t trim_threshold = HEAP_TRIM_THRESHOLD;
+static size_t trim_keep = HEAP_TRIM_KEEP;
 
 // Helper: Align size to ALIGN_SIZE
 static inline size_t align_size(size_t size) {
     return (size + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
 }
 
+static inline free_links_t* block_links(block_header_t* block) {
+    return (free_links_t*)((uint8_t*)block + BLOCK_HEADER_SIZE);
+}
+
+static inline uint32_t size_class(size_t size) {
+    return 63 - __builtin_clzll(size);
+}
+
+// Helper: Physically next header (the epilogue after the last block)
+static inline block_header_t* phys_next(block_header_t* block) {
+    return (block_header_t*)((uint8_t*)block + BLOCK_HEADER_SIZE + block->size);
+}
+
+// Helper: Physically next block, or NULL at the end of the heap
+static inline block_header_t* next_block(block_header_t* block) {
+    block_header_t* next = phys_next(block);
+    return ((uint8_t*)next < heap_end) ? next : NULL;
+}
+
+static inline uintptr_t page_align_up(uintptr_t value) {
+    return (value + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+}
+
+static inline size_t* block_footer(block_header_t* block) {
+    return (size_t*)((uint8_t*)block + BLOCK_HEADER_SIZE + block->size) - 1;
+}
+
+// Helper: Physically previous block (only valid when prev_free is set)
+static inline block_header_t* prev_block(block_header_t* block) {
+    size_t prev_size = *((size_t*)block - 1);
+    return (block_header_t*)((uint8_t*)block - prev_size - BLOCK_HEADER_SIZE);
+}
+
+// Helper: Mark a block free, writing its footer for the block after it
+static void set_free(block_header_t* block) {
+    block->is_free = 1;
+    *block_footer(block) = block->size;
+    phys_next(block)->prev_free = 1;
+}
+
+static void set_used(block_header_t* block) {
+    block->is_free = 0;
+    phys_next(block)->prev_free = 0;
+}
+
+static void write_epilogue(void) {
+    block_header_t* epilogue = (block_header_t*)heap_end;
+    epilogue->size = 0;
+    epilogue->is_free = 0;
+    epilogue->prev_free = 0;
+}
+
+static void free_list_insert(block_header_t* block) {
+    uint32_t cls = size_class(block->size);
+    free_links_t* links = block_links(block);
+    
+    links->prev = NULL;
+    links->next = free_lists[cls];
+    if (links->next) {
+        block_links(links->next)->prev = block;
+    }
+    free_lists[cls] = block;
+    nonempty_classes |= 1ULL << cls;
+}
+
+static void free_list_remove(block_header_t* block) {
+    uint32_t cls = size_class(block->size);
+    free_links_t* links = block_links(block);
+    
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        free_lists[cls] = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+    
+    if (!free_lists[cls]) {
+        nonempty_classes &= ~(1ULL << cls);
+    }
+}
+
 // Helper: Find free block that fits
 static block_header_t* find_free_block(size_t size) {
-    block_header_t* current = free_list;
+    uint32_t cls = size_class(size);
+    
+    // Every block in a class above the one size falls in is big enough
+    uint64_t fits = (cls + 1 < HEAP_CLASSES) ? nonempty_classes & (~0ULL << (cls + 1)) : 0;
+    if (fits) {
+        return free_lists[__builtin_ctzll(fits)];
+    }
     
-    while (current) {
-        if (current->is_free && current->size >= size) {
+    // Otherwise first fit within size's own class
+    for (block_header_t* current = free_lists[cls]; current;
+         current = block_links(current)->next) {
+        if (current->size >= size) {
             return current;
         }
-        current = current->next;
     }
     
     return NULL;
@@ -38,77 +164,354 @@ static block_header_t* find_free_block(size_t size) {
 
 // Helper: Split block if it's too large
 static void split_block(block_header_t* block, size_t size) {
-    if (block->size >= size + BLOCK_HEADER_SIZE + ALIGN_SIZE) {
+    if (block->size >= size + BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE) {
         // Create new block from remaining space
         block_header_t* new_block = (block_header_t*)((uint8_t*)block + BLOCK_HEADER_SIZE + size);
         new_block->size = block->size - size - BLOCK_HEADER_SIZE;
-        new_block->is_free = 1;
-        new_block->next = block->next;
+        new_block->prev_free = 0;
+        set_free(new_block);
+        free_list_insert(new_block);
         
         block->size = size;
-        block->next = new_block;
     }
 }
 
-// Helper: Merge adjacent free blocks
-static void merge_free_blocks(void) {
-    block_header_t* current = free_list;
+// Helper: Copy a payload; sizes and addresses are ALIGN_SIZE multiples
+static inline void copy_payload(void* dest, const void* src, size_t size) {
+    size_t count = size / 8;
+    __asm__ volatile ("rep movsq"
+                      : "+D"(dest), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+// Helper: Absorb free physical neighbours into a block being freed
+// Returns the merged block, which is not on any free list yet
+static block_header_t* coalesce(block_header_t* block) {
+    block_header_t* next = next_block(block);
+    if (next && next->is_free) {
+        free_list_remove(next);
+        block->size += BLOCK_HEADER_SIZE + next->size;
+    }
+    
+    if (block->prev_free) {
+        block_header_t* prev = prev_block(block);
+        free_list_remove(prev);
+        prev->size += BLOCK_HEADER_SIZE + block->size;
+        block = prev;
+    }
+    
+    return block;
+}
+
+// Helper: Give the tail of a used block beyond size back to the free lists
+static void shrink_block(block_header_t* block, size_t size) {
+    if (block->size < size + BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE) {
+        return;
+    }
+    
+    block_header_t* tail = (block_header_t*)((uint8_t*)block + BLOCK_HEADER_SIZE + size);
+    tail->size = block->size - size - BLOCK_HEADER_SIZE;
+    tail->prev_free = 0;
+    tail->is_free = 0;
+    block->size = size;
+    used_size -= tail->size + BLOCK_HEADER_SIZE;
+    
+    tail = coalesce(tail);
+    set_free(tail);
+    free_list_insert(tail);
+}
+
+// Helper: Find or claim the profiling tag of a caller
+static uint16_t tag_lookup(uintptr_t caller) {
+    uint32_t slots = HEAP_PROFILE_TAGS - 1;
+    uint32_t slot = (caller >> 2) % slots;
+    
+    for (uint32_t n = 0; n < slots; n++) {
+        heap_tag_info_t* tag = &tags[slot + 1];
+        if (tag->caller == caller) {
+            return slot + 1;
+        }
+        if (tag->caller == 0) {
+            tag->caller = caller;
+            return slot + 1;
+        }
+        slot = (slot + 1) % slots;
+    }
+    return 0;
+}
+
+// Helper: Histogram bucket of a size (up to 32, 128, 512, ... bytes)
+static inline uint32_t hist_bucket(size_t size) {
+    if (size <= MIN_BLOCK_SIZE) {
+        return 0;
+    }
+    uint32_t bucket = (size_class(size - 1) - 3) / 2;
+    return bucket < HEAP_HIST_BUCKETS ? bucket : HEAP_HIST_BUCKETS - 1;
+}
+
+// Helper: Account a block just handed out to caller
+static void profile_alloc(block_header_t* block, uintptr_t caller) {
+    if (used_size > peak_size) {
+        peak_size = used_size;
+    }
+    if (!profiling) {
+        block->tag = HEAP_TAG_NONE;
+        return;
+    }
+    
+    block->tag = tag_lookup(caller);
+    heap_tag_info_t* tag = &tags[block->tag];
+    tag->allocs++;
+    tag->histogram[hist_bucket(block->size)]++;
+    tag->live_bytes += block->size;
+    if (tag->live_bytes > tag->peak_bytes) {
+        tag->peak_bytes = tag->live_bytes;
+    }
+}
+
+// Helper: Account a block resized in place from old_size
+static void profile_resize(block_header_t* block, size_t old_size) {
+    if (used_size > peak_size) {
+        peak_size = used_size;
+    }
+    if (block->tag == HEAP_TAG_NONE) {
+        return;
+    }
+    
+    heap_tag_info_t* tag = &tags[block->tag];
+    tag->live_bytes += block->size - old_size;
+    if (tag->live_bytes > tag->peak_bytes) {
+        tag->peak_bytes = tag->live_bytes;
+    }
+}
+
+static void profile_free(block_header_t* block) {
+    if (block->tag == HEAP_TAG_NONE) {
+        return;
+    }
+    
+    heap_tag_info_t* tag = &tags[block->tag];
+    tag->frees++;
+    tag->live_bytes -= block->size;
+}
+
+// Helper: Unmap the heap pages that were touched in [start, end) and hand
+// their frames back to the PMM
+static void heap_unmap(uintptr_t start, uintptr_t end) {
+    vmm_batch_begin();
+    for (uintptr_t virt = start; virt < end; virt += PAGE_SIZE) {
+        uint64_t phys = vmm_get_physical_address(virt);
+        if (!phys) continue;
+        
+        vmm_unmap_page(virt);
+        pmm_free_page(phys);
+    }
+    vmm_batch_end();
+}
+
+// Helper: Extend the heap so a free block of at least size bytes exists
+static int heap_grow(size_t size) {
+    uintptr_t top = (uintptr_t)heap_end + BLOCK_HEADER_SIZE;
+    size_t bytes = page_align_up(size + BLOCK_HEADER_SIZE);
+    if (bytes < HEAP_GROW_MIN) {
+        bytes = HEAP_GROW_MIN;
+    }
+    
+    // Pages come on first touch, but don't promise what the PMM can't back
+    if (top + bytes > KERNEL_HEAP_LIMIT || bytes > pmm_get_free_memory()) {
+        return -1;
+    }
+    
+    // Move the break first: the new epilogue is the first touch past it
+    if (vmm_resize_lazy_region(KERNEL_HEAP_BASE, top + bytes - KERNEL_HEAP_BASE) != 0) {
+        return -1;
+    }
+    
+    // The old epilogue becomes the header of the new space; its prev_free
+    // already describes the block before it
+    block_header_t* block = (block_header_t*)heap_end;
+    block->size = bytes - BLOCK_HEADER_SIZE;
+    heap_end += bytes;
+    write_epilogue();
+    total_size += bytes;
+    
+    block = coalesce(block);
+    set_free(block);
+    free_list_insert(block);
+    return 0;
+}
+
+// Helper: Unlink a free block of at least size bytes, growing the heap
+// if none fits
+static block_header_t* take_free_block(size_t size) {
+    block_header_t* block = find_free_block(size);
+    if (!block) {
+        if (heap_grow(size) != 0) {
+            return NULL;
+        }
+        block = find_free_block(size);
+    }
+    
+    free_list_remove(block);
+    return block;
+}
+
+// Helper: Return whole pages at the top of the heap to the PMM once more
+// than trim_threshold is free there, keeping trim_keep for the next burst
+static void heap_trim(void) {
+    block_header_t* epilogue = (block_header_t*)heap_end;
+    if (!epilogue->prev_free) {
+        return;
+    }
+    
+    block_header_t* last = prev_block(epilogue);
+    if (last->size < trim_threshold) {
+        return;
+    }
+    
+    uintptr_t top = (uintptr_t)heap_end + BLOCK_HEADER_SIZE;
+    uintptr_t new_top = page_align_up((uintptr_t)last + 2 * BLOCK_HEADER_SIZE + trim_keep);
+    if (new_top < (uintptr_t)heap_start + HEAP_INITIAL_SIZE) {
+        new_top = (uintptr_t)heap_start + HEAP_INITIAL_SIZE;
+    }
+    if (new_top >= top) {
+        return;
+    }
+    
+    free_list_remove(last);
+    heap_end = (uint8_t*)new_top - BLOCK_HEADER_SIZE;
+    last->size = (uintptr_t)heap_end - (uintptr_t)last - BLOCK_HEADER_SIZE;
+    write_epilogue();
+    set_free(last);
+    free_list_insert(last);
+    
+    vmm_resize_lazy_region(KERNEL_HEAP_BASE, new_top - KERNEL_HEAP_BASE);
+    heap_unmap(new_top, top);
+    total_size -= top - new_top;
+}
+
+// Compaction moved one of our pages: point its heap address at the copy
+static int heap_migrate(uint64_t old_phys, uint64_t new_phys) {
+    uintptr_t top = (uintptr_t)heap_end + BLOCK_HEADER_SIZE;
     
-    while (current && current->next) {
-        if (current->is_free && current->next->is_free) {
-            // Merge with next block
-            current->size += BLOCK_HEADER_SIZE + current->next->size;
-            current->next = current->next->next;
-        } else {
-            current = current->next;
+    for (uintptr_t virt = (uintptr_t)heap_start; virt < top; virt += PAGE_SIZE) {
+        if (vmm_get_physical_address(virt) == old_phys) {
+            return vmm_map_page(virt, new_phys, PAGE_PRESENT | PAGE_WRITABLE);
         }
     }
+    return -1;
+}
+
+#ifdef HEAP_DEBUG
+static void heap_verify_fail(const char* reason) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+    console_write("\n[HEAP] Verify failed: ");
+    console_write(reason);
+    console_write("\nSystem halted!\n");
+    while (1) __asm__ volatile("cli; hlt");
 }
 
-void heap_init(void* start, size_t size) {
-    heap_start = (uint8_t*)start;
-    heap_end = heap_start + size;
-    total_size = size;
+// Helper: Walk the whole heap and check the block chain against the lists
+static void heap_verify(void) {
+    size_t free_blocks = 0;
+    size_t listed = 0;
+    uint32_t prev_free = 0;
+    
+    for (block_header_t* block = (block_header_t*)heap_start; block; block = next_block(block)) {
+        if (block->prev_free != prev_free) {
+            heap_verify_fail("prev_free out of sync");
+        }
+        if (block->is_free) {
+            if (prev_free) heap_verify_fail("adjacent free blocks");
+            if (*block_footer(block) != block->size) heap_verify_fail("bad footer");
+            free_blocks++;
+        }
+        prev_free = block->is_free;
+    }
+    if (((block_header_t*)heap_end)->prev_free != prev_free) {
+        heap_verify_fail("epilogue out of sync");
+    }
+    
+    for (int cls = 0; cls < HEAP_CLASSES; cls++) {
+        for (block_header_t* block = free_lists[cls]; block; block = block_links(block)->next) {
+            if (!block->is_free || size_class(block->size) != (uint32_t)cls) {
+                heap_verify_fail("bad free list entry");
+            }
+            listed++;
+        }
+    }
+    
+    if (listed != free_blocks) {
+        heap_verify_fail("free list count mismatch");
+    }
+}
+#endif
+
+void heap_init(void) {
+    heap_start = (uint8_t*)KERNEL_HEAP_BASE;
     used_size = 0;
     
+    for (int i = 0; i < HEAP_CLASSES; i++) {
+        free_lists[i] = NULL;
+    }
+    nonempty_classes = 0;
+    
+    // Demand-zero up to the break only, so stray pointers into the rest
+    // of the window still fault
+    if (vmm_add_lazy_region(KERNEL_HEAP_BASE, HEAP_INITIAL_SIZE,
+                            PAGE_WRITABLE, PG_HEAP | PG_MOVABLE) != 0) {
+        heap_start = NULL;
+        console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+        console_write("[HEAP] ERROR: Failed to reserve the kernel heap!\n");
+        console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+        return;
+    }
+    total_size = HEAP_INITIAL_SIZE;
+    heap_end = heap_start + HEAP_INITIAL_SIZE - BLOCK_HEADER_SIZE;
+    write_epilogue();
+    
     // Create initial free block
-    free_list = (block_header_t*)heap_start;
-    free_list->size = size - BLOCK_HEADER_SIZE;
-    free_list->next = NULL;
-    free_list->is_free = 1;
+    block_header_t* block = (block_header_t*)heap_start;
+    block->size = HEAP_INITIAL_SIZE - 2 * BLOCK_HEADER_SIZE;
+    block->prev_free = 0;
+    set_free(block);
+    free_list_insert(block);
+    
+    pmm_set_migrate_handler(PG_HEAP, heap_migrate);
     
     console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
     console_write("[HEAP] Kernel heap initialized (");
-    
-    // Print heap size in KB/MB
-    if (size >= 1024 * 1024) {
-        size_t mb = size / (1024 * 1024);
-        console_putchar('0' + (mb / 10));
-        console_putchar('0' + (mb % 10));
-        console_write(" MB)\n");
-    } else {
-        size_t kb = size / 1024;
-        if (kb >= 1000) console_putchar('0' + (kb / 1000));
-        if (kb >= 100) console_putchar('0' + ((kb / 100) % 10));
-        if (kb >= 10) console_putchar('0' + ((kb / 10) % 10));
-        console_putchar('0' + (kb % 10));
-        console_write(" KB)\n");
-    }
-    
+    console_write_dec(HEAP_INITIAL_SIZE / 1024);
+    console_write(" KB, grows on demand)\n");
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
 }
 
-void* kmalloc(size_t size) {
+void heap_set_trim(size_t threshold, size_t keep) {
+    // Keep the gap wide enough that trimming can't immediately regrow
+    if (keep < HEAP_GROW_MIN) {
+        keep = HEAP_GROW_MIN;
+    }
+    if (threshold < keep + HEAP_GROW_MIN) {
+        threshold = keep + HEAP_GROW_MIN;
+    }
+    trim_threshold = threshold;
+    trim_keep = keep;
+}
+
+// Helper: kmalloc on behalf of caller
+static void* heap_alloc(size_t size, uintptr_t caller) {
     if (size == 0 || !heap_start) {
         return NULL;
     }
     
     // Align size
     size = align_size(size);
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
     
-    // Find free block
-    block_header_t* block = find_free_block(size);
-    
+    block_header_t* block = take_free_block(size);
     if (!block) {
         return NULL;  // Out of memory
     }
@@ -117,22 +520,77 @@ void* kmalloc(size_t size) {
     split_block(block, size);
     
     // Mark as allocated
-    block->is_free = 0;
-    used_size += size + BLOCK_HEADER_SIZE;
-    
+    set_used(block);
+    used_size += block->size + BLOCK_HEADER_SIZE;
+    profile_alloc(block, caller);
+
+#ifdef HEAP_DEBUG
+    heap_verify();
+#endif
+
     // Return pointer to data (after header)
     return (void*)((uint8_t*)block + BLOCK_HEADER_SIZE);
 }
 
+void* kmalloc(size_t size) {
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
+
 void* kmalloc_aligned(size_t size, size_t alignment) {
-    // Simple implementation: just align to alignment
-    size_t aligned_size = (size + alignment - 1) & ~(alignment - 1);
-    return kmalloc(aligned_size);
+    uintptr_t caller = (uintptr_t)__builtin_return_address(0);
+    if (alignment <= ALIGN_SIZE) {
+        return heap_alloc(size, caller);
+    }
+    if (size == 0 || !heap_start || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    
+    size = align_size(size);
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
+    
+    // Worst case the aligned payload sits alignment bytes in, behind a
+    // leading slack block of its own
+    size_t lead_min = BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE;
+    block_header_t* block = take_free_block(size + alignment + lead_min);
+    if (!block) {
+        return NULL;  // Out of memory
+    }
+    
+    uintptr_t payload = (uintptr_t)block + BLOCK_HEADER_SIZE;
+    uintptr_t aligned = (payload + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != payload && aligned - payload < lead_min) {
+        aligned += alignment;
+    }
+    
+    // Carve the aligned block out and put the slack in front back as a
+    // free block (its previous neighbour is in use, nothing to merge)
+    if (aligned != payload) {
+        block_header_t* lead = block;
+        block = (block_header_t*)(aligned - BLOCK_HEADER_SIZE);
+        block->size = lead->size - (aligned - payload);
+        block->is_free = 0;
+        lead->size = aligned - payload - BLOCK_HEADER_SIZE;
+        set_free(lead);
+        free_list_insert(lead);
+    }
+    
+    split_block(block, size);
+    set_used(block);
+    used_size += block->size + BLOCK_HEADER_SIZE;
+    profile_alloc(block, caller);
+
+#ifdef HEAP_DEBUG
+    heap_verify();
+#endif
+
+    return (void*)aligned;
 }
 
 void* kcalloc(size_t nmemb, size_t size) {
     size_t total = nmemb * size;
-    void* ptr = kmalloc(total);
+    void* ptr = heap_alloc(total, (uintptr_t)__builtin_return_address(0));
     
     if (ptr) {
         // Zero out memory
@@ -146,8 +604,9 @@ void* kcalloc(size_t nmemb, size_t size) {
 }
 
 void* krealloc(void* ptr, size_t size) {
+    uintptr_t caller = (uintptr_t)__builtin_return_address(0);
     if (!ptr) {
-        return kmalloc(size);
+        return heap_alloc(size, caller);
     }
     
     if (size == 0) {
@@ -157,24 +616,52 @@ void* krealloc(void* ptr, size_t size) {
     
     // Get old block header
     block_header_t* old_block = (block_header_t*)((uint8_t*)ptr - BLOCK_HEADER_SIZE);
+    size_t old_size = old_block->size;
+    
+    size = align_size(size);
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
+    
+    // At the top of the heap, map more so the block can grow in place
+    block_header_t* next = phys_next(old_block);
+    if (old_block->size < size) {
+        block_header_t* last = next->is_free ? next : old_block;
+        size_t have = old_block->size + (next->is_free ? BLOCK_HEADER_SIZE + next->size : 0);
+        if ((uint8_t*)phys_next(last) == heap_end && have < size &&
+            heap_grow(size - have) == 0) {
+            next = phys_next(old_block);
+        }
+    }
+    
+    // Grow into the free block after us
+    if (old_block->size < size && next->is_free &&
+        old_block->size + BLOCK_HEADER_SIZE + next->size >= size) {
+        free_list_remove(next);
+        old_block->size += BLOCK_HEADER_SIZE + next->size;
+        used_size += BLOCK_HEADER_SIZE + next->size;
+        set_used(old_block);
+    }
     
     if (old_block->size >= size) {
-        // Block is large enough, just return it
+        // Fits in place: hand back whatever is left over
+        shrink_block(old_block, size);
+        profile_resize(old_block, old_size);
+        heap_trim();
+
+#ifdef HEAP_DEBUG
+        heap_verify();
+#endif
         return ptr;
     }
     
     // Allocate new block
-    void* new_ptr = kmalloc(size);
+    void* new_ptr = heap_alloc(size, caller);
     if (!new_ptr) {
         return NULL;
     }
     
-    // Copy old data
-    uint8_t* src = (uint8_t*)ptr;
-    uint8_t* dst = (uint8_t*)new_ptr;
-    for (size_t i = 0; i < old_block->size; i++) {
-        dst[i] = src[i];
-    }
+    copy_payload(new_ptr, ptr, old_block->size);
     
     // Free old block
     kfree(ptr);
@@ -189,13 +676,21 @@ void kfree(void* ptr) {
     
     // Get block header
     block_header_t* block = (block_header_t*)((uint8_t*)ptr - BLOCK_HEADER_SIZE);
+    if (block->is_free) {
+        return;  // Double free
+    }
     
-    // Mark as free
-    block->is_free = 1;
+    // Mark as free and merge with free neighbours
     used_size -= block->size + BLOCK_HEADER_SIZE;
-    
-    // Merge adjacent free blocks
-    merge_free_blocks();
+    profile_free(block);
+    block = coalesce(block);
+    set_free(block);
+    free_list_insert(block);
+    heap_trim();
+
+#ifdef HEAP_DEBUG
+    heap_verify();
+#endif
 }
 
 size_t heap_get_used(void) {
@@ -205,3 +700,78 @@ size_t heap_get_used(void) {
 size_t heap_get_free(void) {
     return total_size - used_size;
 }
+
+size_t heap_get_peak(void) {
+    return peak_size;
+}
+
+size_t heap_get_largest_free(void) {
+    if (!nonempty_classes) {
+        return 0;
+    }
+    
+    // Only the highest non-empty class can hold the largest block
+    size_t largest = 0;
+    uint32_t cls = 63 - __builtin_clzll(nonempty_classes);
+    for (block_header_t* block = free_lists[cls]; block; block = block_links(block)->next) {
+        if (block->size > largest) {
+            largest = block->size;
+        }
+    }
+    return largest;
+}
+
+uint32_t heap_get_fragmentation(void) {
+    size_t free = heap_get_free();
+    if (free == 0) {
+        return 0;
+    }
+    return 100 - (uint32_t)(heap_get_largest_free() * 100 / free);
+}
+
+void heap_profile_enable(int enable) {
+    profiling = enable;
+}
+
+int heap_profile_enabled(void) {
+    return profiling;
+}
+
+int heap_get_tag_info(int index, heap_tag_info_t* info) {
+    int seen = 0;
+    
+    for (int i = 0; i < HEAP_PROFILE_TAGS; i++) {
+        if (tags[i].allocs == 0) continue;
+        if (seen++ != index) continue;
+        
+        *info = tags[i];
+        return 0;
+    }
+    
+    return -1;
+}
+
+void heap_debug_info(void) {
+    size_t blocks = 0;
+    size_t free_blocks = 0;
+    size_t largest_free = 0;
+    
+    // Whole-heap walk: debugging only
+    for (block_header_t* block = (block_header_t*)heap_start; block; block = next_block(block)) {
+        blocks++;
+        if (block->is_free) {
+            free_blocks++;
+            if (block->size > largest_free) {
+                largest_free = block->size;
+            }
+        }
+    }
+    
+    console_write("[HEAP] Blocks: ");
+    console_write_dec(blocks);
+    console_write(", free: ");
+    console_write_dec(free_blocks);
+    console_write(", largest free: ");
+    console_write_dec(largest_free);
+    console_write(" bytes\n");
+}
@@ -1,187 +1,1043 @@
 #include <mm/pmm.h>
+#include <mm/memlayout.h>
+#include <multiboot/multiboot2.h>
 #include <ui/console.h>
 
-// Bitmap to track page usage (1 bit per page)
-// Each uint32_t tracks 32 pages
-#define MAX_BLOCKS 32768  // Support up to 4GB RAM (32768 * 32 * 4KB)
-static uint32_t memory_bitmap[MAX_BLOCKS];
-static uint64_t total_blocks = 0;
-static uint64_t used_blocks = 0;
-static uint64_t total_memory = 0;
+// Kernel image bounds (linker.ld, virtual)
+extern uint8_t _kernel_start[];
+extern uint8_t _kernel_end[];
 
-// Helper: Set bit in bitmap (mark page as used)
-static inline void bitmap_set(uint32_t bit) {
-    uint32_t block = bit / 32;
-    uint32_t offset = bit % 32;
-    if (block < MAX_BLOCKS) {
-        memory_bitmap[block] |= (1 << offset);
+// Usable RAM is described by a handful of regions built from the Multiboot2
+// memory map. Each region keeps its own page bitmap (1 bit per page) and
+// page frame database (one struct page per page), both stored in the
+// region's first pages, so metadata only exists for memory that is there.
+//
+// Build with -DPMM_DEBUG to check the zone fallback at boot.
+#define PMM_MAX_REGIONS 32  // One bit each in region_free_mask
+
+// Buddy allocator
+// Free blocks of 2^order pages sit on per-order lists. The list node lives
+// in the first page of each free block (through the direct map); the head's
+// struct page carries PG_BUDDY and the block order so buddies can be
+// checked without touching the block itself.
+typedef struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+typedef struct {
+    uint64_t base;          // First page frame number
+    uint64_t pages;         // Pages in the region, metadata included
+    uint64_t* bitmap;       // Page usage bitmap (1 = used)
+    struct page* page_db;   // Page frame database, indexed by pfn - base
+    free_block_t* free_area[PMM_MAX_ORDER + 1];
+    uint32_t free_mask;     // Bit n set when free_area[n] is non-empty
+    int zone;               // ZONE_* (regions never straddle a zone limit)
+    int online;             // Bitmap built and pages handed to the buddy lists
+} pmm_region_t;
+
+static pmm_region_t regions[PMM_MAX_REGIONS];
+static int region_count = 0;
+
+// Two-level summary: region_free_mask picks regions with any free block,
+// each region's free_mask picks the smallest order that fits. Both are
+// searched with a bit scan, so finding a block never walks lists or orders.
+static uint32_t region_free_mask = 0;
+
+typedef struct {
+    const char* name;
+    uint64_t limit;         // First address above the zone
+    uint32_t low_shift;     // Low watermark is total_pages >> low_shift
+    uint64_t total_pages;
+    uint64_t free_pages;
+    uint64_t low_pages;
+    uint64_t high_pages;
+    uint32_t region_mask;   // Online regions in the zone
+    int alloc_hint;         // Next-fit: region that served the last request
+} pmm_zone_t;
+
+// ZONE_DMA keeps a quarter of itself back from general allocations
+static pmm_zone_t zones[PMM_ZONES] = {
+    { "DMA",    ZONE_DMA_LIMIT,   2, 0, 0, 0, 0, 0, 0 },
+    { "DMA32",  ZONE_DMA32_LIMIT, 6, 0, 0, 0, 0, 0, 0 },
+    { "Normal", ~0ULL,            6, 0, 0, 0, 0, 0, 0 },
+};
+
+// Pre-zeroed pages, allocated PG_KERNEL and handed out as a stack
+static uint64_t zero_pool[PMM_ZERO_POOL_PAGES];
+static uint64_t zero_pool_count = 0;
+static uint64_t zero_pool_hits = 0;
+static uint64_t zero_pool_misses = 0;
+
+// Owners that can move their PG_MOVABLE pages, indexed by type bit
+static pmm_migrate_fn migrate_handlers[PG_TYPES];
+
+// Pages per PG_* type, indexed by bit number; used memory is derived
+// from these rather than kept as a separate counter
+static uint64_t total_pages = 0;
+static uint64_t type_pages[PG_TYPES];
+
+// Helper: Bits [offset, offset + n) of a bitmap word
+static inline uint64_t word_mask(uint32_t offset, uint32_t n) {
+    return (n == 64) ? ~0ULL : (((1ULL << n) - 1) << offset);
+}
+
+// Helper: Test bit in bitmap
+static inline int bitmap_test(pmm_region_t* region, uint64_t pfn) {
+    uint64_t bit = pfn - region->base;
+    return (region->bitmap[bit / 64] & (1ULL << (bit % 64))) != 0;
+}
+
+// Helper: Mark a run of pages used or free, a word at a time
+static void bitmap_fill(pmm_region_t* region, uint64_t pfn, uint64_t count, int used) {
+    uint64_t start = pfn - region->base;
+    
+    while (count > 0) {
+        uint64_t block = start / 64;
+        uint32_t offset = start % 64;
+        uint32_t n = 64 - offset;
+        if (n > count) n = count;
+        
+        uint64_t mask = word_mask(offset, n);
+        if (used) {
+            region->bitmap[block] |= mask;
+        } else {
+            region->bitmap[block] &= ~mask;
+        }
+        
+        start += n;
+        count -= n;
     }
 }
 
-// Helper: Clear bit in bitmap (mark page as free)
-static inline void bitmap_clear(uint32_t bit) {
-    uint32_t block = bit / 32;
-    uint32_t offset = bit % 32;
-    if (block < MAX_BLOCKS) {
-        memory_bitmap[block] &= ~(1 << offset);
+// Helper: Check that every page in a run is marked used
+static int bitmap_range_used(pmm_region_t* region, uint64_t pfn, uint64_t count) {
+    uint64_t start = pfn - region->base;
+    
+    while (count > 0) {
+        uint64_t block = start / 64;
+        uint32_t offset = start % 64;
+        uint32_t n = 64 - offset;
+        if (n > count) n = count;
+        
+        uint64_t mask = word_mask(offset, n);
+        if ((region->bitmap[block] & mask) != mask) {
+            return 0;
+        }
+        
+        start += n;
+        count -= n;
     }
+    return 1;
 }
 
-// Helper: Test bit in bitmap
-static inline int bitmap_test(uint32_t bit) {
-    uint32_t block = bit / 32;
-    uint32_t offset = bit % 32;
-    if (block < MAX_BLOCKS) {
-        return (memory_bitmap[block] & (1 << offset)) != 0;
+static inline free_block_t* pfn_to_block(uint64_t pfn) {
+    return (free_block_t*)phys_to_virt(pfn * PAGE_SIZE);
+}
+
+static inline struct page* region_page(pmm_region_t* region, uint64_t pfn) {
+    return &region->page_db[pfn - region->base];
+}
+
+// Helper: Clear a page eight bytes at a time
+static inline void zero_page(uint64_t addr) {
+    void* dest = phys_to_virt(addr);
+    uint64_t count = PAGE_SIZE / 8;
+    __asm__ volatile ("rep stosq"
+                      : "+D"(dest), "+c"(count)
+                      : "a"(0ULL)
+                      : "memory");
+}
+
+// Helper: Copy a page eight bytes at a time
+static inline void copy_page(uint64_t dest, uint64_t src) {
+    void* to = phys_to_virt(dest);
+    void* from = phys_to_virt(src);
+    uint64_t count = PAGE_SIZE / 8;
+    __asm__ volatile ("rep movsq"
+                      : "+D"(to), "+S"(from), "+c"(count)
+                      :
+                      : "memory");
+}
+
+static inline uint32_t type_index(uint32_t flags) {
+    return __builtin_ctz(flags & PG_TYPE_MASK);
+}
+
+// Helper: Retag a run of pages, keeping the per-type counts in step
+static void page_set_range(pmm_region_t* region, uint64_t pfn, uint64_t count,
+                           uint32_t type) {
+    struct page* page = region_page(region, pfn);
+    uint32_t refcount = (type == PG_FREE) ? 0 : 1;
+    uint64_t was_free = 0;
+    
+    for (uint64_t i = 0; i < count; i++, page++) {
+        if (page->flags & PG_FREE) {
+            was_free++;
+        }
+        type_pages[type_index(page->flags)]--;
+        page->flags = type;
+        page->refcount = refcount;
     }
-    return 0;
+    type_pages[type_index(type)] += count;
+    
+    zones[region->zone].free_pages -= was_free;
+    if (type == PG_FREE) {
+        zones[region->zone].free_pages += count;
+    }
+}
+
+static inline uint64_t block_to_pfn(free_block_t* block) {
+    return virt_to_phys(block) / PAGE_SIZE;
+}
+
+// Helper: Find the online region holding a page frame
+static pmm_region_t* pfn_to_region(uint64_t pfn) {
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].online && pfn >= regions[i].base &&
+            pfn < regions[i].base + regions[i].pages) {
+            return &regions[i];
+        }
+    }
+    return NULL;
+}
+
+// Helper: Smallest order whose block holds count pages
+static uint32_t order_for_count(size_t count) {
+    uint32_t order = 0;
+    while (((size_t)1 << order) < count) {
+        order++;
+    }
+    return order;
+}
+
+static void free_list_add(pmm_region_t* region, uint64_t pfn, uint32_t order) {
+    free_block_t* block = pfn_to_block(pfn);
+    struct page* head = region_page(region, pfn);
+    head->flags |= PG_BUDDY;
+    head->order = order;
+    
+    block->prev = NULL;
+    block->next = region->free_area[order];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    region->free_area[order] = block;
+    
+    region->free_mask |= 1u << order;
+    region_free_mask |= 1u << (region - regions);
+}
+
+static void free_list_remove(pmm_region_t* region, free_block_t* block) {
+    struct page* head = region_page(region, block_to_pfn(block));
+    uint32_t order = head->order;
+    head->flags &= ~PG_BUDDY;
+    
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        region->free_area[order] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    
+    if (!region->free_area[order]) {
+        region->free_mask &= ~(1u << order);
+        if (!region->free_mask) {
+            region_free_mask &= ~(1u << (region - regions));
+        }
+    }
+}
+
+// Helper: Take a block of 2^order pages, splitting a larger one if needed
+// Returns the first page frame number, or 0 when the region is exhausted
+static uint64_t buddy_alloc(pmm_region_t* region, uint32_t order, uint32_t type) {
+    uint32_t fits = region->free_mask & (~0u << order);
+    if (!fits) {
+        return 0;
+    }
+    
+    uint32_t current = __builtin_ctz(fits);
+    free_block_t* block = region->free_area[current];
+    free_list_remove(region, block);
+    uint64_t pfn = block_to_pfn(block);
+    
+    // Hand the upper halves back until the block is the requested size
+    while (current > order) {
+        current--;
+        free_list_add(region, pfn + (1ULL << current), current);
+    }
+    
+    bitmap_fill(region, pfn, 1ULL << order, 1);
+    page_set_range(region, pfn, 1ULL << order, type);
+    region_page(region, pfn)->order = order;
+    
+    return pfn;
 }
 
-// Helper: Find first free page
-static int find_free_page(void) {
-    for (uint32_t i = 0; i < total_blocks; i++) {
-        if (memory_bitmap[i] != 0xFFFFFFFF) {
-            // This block has free pages
-            for (int j = 0; j < 32; j++) {
-                if (!(memory_bitmap[i] & (1 << j))) {
-                    return i * 32 + j;
+// Helper: Release an aligned block and coalesce it with free buddies
+static void buddy_free(pmm_region_t* region, uint64_t pfn, uint32_t order) {
+    bitmap_fill(region, pfn, 1ULL << order, 0);
+    page_set_range(region, pfn, 1ULL << order, PG_FREE);
+    
+    while (order < PMM_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ULL << order);
+        if (buddy < region->base ||
+            buddy + (1ULL << order) > region->base + region->pages) {
+            break;
+        }
+        
+        struct page* buddy_page = region_page(region, buddy);
+        if (!(buddy_page->flags & PG_BUDDY) || buddy_page->order != order) {
+            break;
+        }
+        
+        free_list_remove(region, pfn_to_block(buddy));
+        pfn &= ~(1ULL << order);
+        order++;
+    }
+    
+    free_list_add(region, pfn, order);
+}
+
+// Helper: Release an arbitrary run as the largest aligned blocks that fit
+// Pages that are already free are skipped
+static void buddy_free_range(pmm_region_t* region, uint64_t pfn, uint64_t count) {
+    uint64_t end = pfn + count;
+    if (end > region->base + region->pages) {
+        end = region->base + region->pages;
+    }
+    
+    while (pfn < end) {
+        uint32_t order = 0;
+        while (order < PMM_MAX_ORDER &&
+               (pfn & ((2ULL << order) - 1)) == 0 &&
+               pfn + (2ULL << order) <= end) {
+            order++;
+        }
+        
+        if (bitmap_range_used(region, pfn, 1ULL << order)) {
+            buddy_free(region, pfn, order);
+        } else {
+            // Partly free already: release the used pages one by one
+            for (uint64_t page = pfn; page < pfn + (1ULL << order); page++) {
+                if (bitmap_test(region, page)) {
+                    buddy_free(region, page, 0);
                 }
             }
         }
+        
+        pfn += 1ULL << order;
+    }
+}
+
+// Helper: Insert a region descriptor at index, shifting the rest up
+static int region_insert(int index, uint64_t base, uint64_t pages) {
+    if (region_count == PMM_MAX_REGIONS) {
+        return -1;
+    }
+    for (int j = region_count; j > index; j--) {
+        regions[j] = regions[j - 1];
     }
-    return -1;  // Out of memory
+    regions[index].base = base;
+    regions[index].pages = pages;
+    regions[index].zone = ZONE_DMA;
+    regions[index].online = 0;
+    region_count++;
+    return 0;
 }
 
-// Helper: Find contiguous free pages
-static int find_free_pages(size_t count) {
-    if (count == 0) return -1;
+// Helper: Add a usable range from the memory map, keeping regions sorted
+static void region_add(uint64_t start, uint64_t end) {
+    uint64_t first = (start + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t last = end / PAGE_SIZE;
     
-    uint32_t found = 0;
-    int start = -1;
+    if (last <= first) {
+        return;
+    }
     
-    for (uint32_t page = 0; page < total_blocks * 32; page++) {
-        if (!bitmap_test(page)) {
-            if (start == -1) {
-                start = page;
+    int i = 0;
+    while (i < region_count && regions[i].base < first) {
+        i++;
+    }
+    region_insert(i, first, last - first);
+}
+
+// Helper: Remove [start, end) from the regions, splitting as needed
+static void region_reserve(uint64_t start, uint64_t end) {
+    uint64_t first = start / PAGE_SIZE;
+    uint64_t last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    for (int i = 0; i < region_count; i++) {
+        pmm_region_t* r = &regions[i];
+        uint64_t r_end = r->base + r->pages;
+        
+        if (last <= r->base || first >= r_end) {
+            continue;
+        }
+        
+        if (first <= r->base && last >= r_end) {
+            // Fully covered: drop the region
+            for (int j = i; j < region_count - 1; j++) {
+                regions[j] = regions[j + 1];
             }
-            found++;
-            
-            if (found == count) {
-                return start;
+            region_count--;
+            i--;
+        } else if (first > r->base && last < r_end) {
+            // Punches a hole: keep the head, insert the tail after it
+            r->pages = first - r->base;
+            if (region_insert(i + 1, last, r_end - last) == 0) {
+                i++;
             }
+        } else if (first <= r->base) {
+            r->pages = r_end - last;
+            r->base = last;
         } else {
-            start = -1;
-            found = 0;
+            r->pages = first - r->base;
+        }
+    }
+}
+
+// Helper: Split any region that straddles the given address
+static void region_split(uint64_t addr) {
+    uint64_t pfn = addr / PAGE_SIZE;
+    
+    for (int i = 0; i < region_count; i++) {
+        pmm_region_t* r = &regions[i];
+        uint64_t r_end = r->base + r->pages;
+        
+        if (pfn > r->base && pfn < r_end) {
+            if (region_insert(i + 1, pfn, r_end - pfn) == 0) {
+                r->pages = pfn - r->base;
+            }
+            return;
+        }
+    }
+}
+
+// Helper: Build the bitmap and page database at the start of a region
+// and free the rest
+static void region_online(pmm_region_t* region) {
+    uint64_t bitmap_words = (region->pages + 63) / 64;
+    uint64_t meta_bytes = bitmap_words * 8 + region->pages * sizeof(struct page);
+    uint64_t meta_pages = (meta_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    if (region->online || region->pages <= meta_pages) {
+        return;
+    }
+    
+    region->zone = ZONE_DMA;
+    while (region->base * PAGE_SIZE >= zones[region->zone].limit) {
+        region->zone++;
+    }
+    
+    region->bitmap = (uint64_t*)phys_to_virt(region->base * PAGE_SIZE);
+    region->page_db = (struct page*)(region->bitmap + bitmap_words);
+    for (uint64_t i = 0; i < bitmap_words; i++) {
+        region->bitmap[i] = ~0ULL;
+    }
+    for (uint64_t i = 0; i < region->pages; i++) {
+        region->page_db[i].refcount = 1;
+        region->page_db[i].flags = PG_KERNEL;
+        region->page_db[i].order = 0;
+        region->page_db[i].zone = region->zone;
+    }
+    for (int order = 0; order <= PMM_MAX_ORDER; order++) {
+        region->free_area[order] = NULL;
+    }
+    region->free_mask = 0;
+    region->online = 1;
+    
+    pmm_zone_t* zone = &zones[region->zone];
+    zone->total_pages += region->pages;
+    zone->low_pages = zone->total_pages >> zone->low_shift;
+    zone->high_pages = zone->low_pages * 2;
+    zone->region_mask |= 1u << (region - regions);
+    
+    total_pages += region->pages;
+    type_pages[type_index(PG_KERNEL)] += region->pages;
+    buddy_free_range(region, region->base + meta_pages, region->pages - meta_pages);
+}
+
+// Helper: Collect usable ranges from the Multiboot2 memory map
+// Falls back to the basic meminfo tag when no map is present
+static void parse_memory_map(void* multiboot_info) {
+    uint8_t* mb = multiboot_info;
+    struct multiboot_tag* tag = (void*)(mb + 8);
+    uint64_t upper_kb = 0;
+    
+    while (tag->type != MULTIBOOT_TAG_TYPE_END) {
+        if (tag->type == MULTIBOOT_TAG_TYPE_MMAP) {
+            struct multiboot_tag_mmap* mmap = (struct multiboot_tag_mmap*)tag;
+            uint8_t* entry = (uint8_t*)mmap->entries;
+            uint8_t* end = (uint8_t*)tag + tag->size;
+            
+            for (; entry < end; entry += mmap->entry_size) {
+                struct multiboot_mmap_entry* e = (struct multiboot_mmap_entry*)entry;
+                if (e->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                    region_add(e->addr, e->addr + e->len);
+                }
+            }
+            return;
+        }
+        if (tag->type == MULTIBOOT_TAG_TYPE_BASIC_MEMINFO) {
+            upper_kb = ((struct multiboot_tag_basic_meminfo*)tag)->mem_upper;
         }
+        tag = (void*)((uint8_t*)tag + ((tag->size + 7) & ~7));
     }
     
-    return -1;  // Not enough contiguous pages
+    region_add(0x100000, 0x100000 + upper_kb * 1024);
 }
 
-void pmm_init(uint64_t mem_size) {
-    total_memory = mem_size;
-    total_blocks = (mem_size / PAGE_SIZE) / 32;
+// Helper: Keep the boot information and loaded modules out of the PMM
+static void reserve_boot_data(void* multiboot_info) {
+    uint8_t* mb = multiboot_info;
+    uint32_t total_size = *(uint32_t*)mb;
+    struct multiboot_tag* tag = (void*)(mb + 8);
     
-    if (total_blocks > MAX_BLOCKS) {
-        total_blocks = MAX_BLOCKS;
+    region_reserve(virt_to_phys(mb), virt_to_phys(mb) + total_size);
+    
+    while (tag->type != MULTIBOOT_TAG_TYPE_END) {
+        if (tag->type == MULTIBOOT_TAG_TYPE_MODULE) {
+            struct multiboot_tag_module* mod = (struct multiboot_tag_module*)tag;
+            region_reserve(mod->mod_start, mod->mod_end);
+        }
+        tag = (void*)((uint8_t*)tag + ((tag->size + 7) & ~7));
+    }
+}
+
+#ifdef PMM_DEBUG
+// Helper: With ZONE_NORMAL still empty, single-page allocations must be
+// able to drain DMA32 completely and DMA down to its low watermark. Takes
+// every such page (chained through their first word), then frees them.
+static void pmm_check_fallback(void) {
+    if (zones[ZONE_NORMAL].total_pages != 0) {
+        return;
+    }
+    
+    uint64_t expected = zones[ZONE_DMA32].free_pages;
+    if (zones[ZONE_DMA].free_pages > zones[ZONE_DMA].low_pages) {
+        expected += zones[ZONE_DMA].free_pages - zones[ZONE_DMA].low_pages;
     }
     
-    // Initially mark all memory as used
-    for (uint32_t i = 0; i < MAX_BLOCKS; i++) {
-        memory_bitmap[i] = 0xFFFFFFFF;
+    uint64_t head = 0;
+    uint64_t taken = 0;
+    uint64_t addr;
+    while ((addr = pmm_alloc_page()) != 0) {
+        *(uint64_t*)phys_to_virt(addr) = head;
+        head = addr;
+        taken++;
     }
+    int drained = zones[ZONE_DMA32].free_pages == 0;
     
-    // Mark available memory as free (skip first 16MB for kernel)
-    uint64_t kernel_pages = (16 * 1024 * 1024) / PAGE_SIZE;
-    uint64_t total_pages = mem_size / PAGE_SIZE;
+    while (head) {
+        uint64_t next = *(uint64_t*)phys_to_virt(head);
+        pmm_free_page(head);
+        head = next;
+    }
     
-    for (uint64_t page = kernel_pages; page < total_pages; page++) {
-        bitmap_clear(page);
+    if (taken != expected || !drained) {
+        console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+        console_write("[PMM] Zone fallback check failed: got ");
+        console_write_dec((uint32_t)taken);
+        console_write(" of ");
+        console_write_dec((uint32_t)expected);
+        console_write(" pages\nSystem halted!\n");
+        while (1) __asm__ volatile("cli; hlt");
+    }
+}
+#endif
+
+void pmm_init(void* multiboot_info) {
+    region_count = 0;
+    region_free_mask = 0;
+    for (int i = 0; i < PMM_ZONES; i++) {
+        zones[i].total_pages = 0;
+        zones[i].free_pages = 0;
+        zones[i].low_pages = 0;
+        zones[i].high_pages = 0;
+        zones[i].region_mask = 0;
+        zones[i].alloc_hint = 0;
+    }
+    total_pages = 0;
+    zero_pool_count = 0;
+    zero_pool_hits = 0;
+    zero_pool_misses = 0;
+    for (int i = 0; i < PG_TYPES; i++) {
+        type_pages[i] = 0;
     }
     
-    used_blocks = kernel_pages / 32;
+    parse_memory_map(multiboot_info);
     
-    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
-    console_write("[PMM] Physical Memory Manager initialized\n");
-    console_write("[PMM] Total Memory: ");
+    // Low memory (BIOS data, EBDA), the kernel image and boot data stay reserved
+    region_reserve(0, 0x100000);
+    region_reserve(virt_to_phys(_kernel_start), virt_to_phys(_kernel_end));
+    reserve_boot_data(multiboot_info);
     
-    // Print memory size in MB
-    uint64_t mem_mb = mem_size / (1024 * 1024);
-    if (mem_mb >= 1000) {
-        console_putchar('0' + (mem_mb / 1000));
-        mem_mb %= 1000;
+    // Regions never straddle a zone limit. Only memory inside the boot
+    // direct map (which ends at the DMA32 limit) can be used right away;
+    // the rest comes online once the VMM has mapped it.
+    region_split(ZONE_DMA_LIMIT);
+    region_split(ZONE_DMA32_LIMIT);
+    for (int i = 0; i < region_count; i++) {
+        if ((regions[i].base + regions[i].pages) * PAGE_SIZE <= PMM_BOOT_MAP_LIMIT) {
+            region_online(&regions[i]);
+        }
     }
-    if (mem_mb >= 100) console_putchar('0' + (mem_mb / 100));
-    if (mem_mb >= 10) console_putchar('0' + ((mem_mb / 10) % 10));
-    console_putchar('0' + (mem_mb % 10));
-    console_write(" MB\n");
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("[PMM] Physical Memory Manager initialized\n");
+    console_write("[PMM] Usable Memory: ");
+    console_write_dec(total_pages * PAGE_SIZE / (1024 * 1024));
+    console_write(" MB in ");
+    console_write_dec(region_count);
+    console_write(" regions\n");
     
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    
+#ifdef PMM_DEBUG
+    pmm_check_fallback();
+#endif
+}
+
+void pmm_online_regions(void) {
+    for (int i = 0; i < region_count; i++) {
+        region_online(&regions[i]);
+    }
+}
+
+int pmm_get_region(int index, uint64_t* base, uint64_t* length) {
+    if (index < 0 || index >= region_count) {
+        return -1;
+    }
+    *base = regions[index].base * PAGE_SIZE;
+    *length = regions[index].pages * PAGE_SIZE;
+    return 0;
 }
 
 uint64_t pmm_alloc_page(void) {
-    int page = find_free_page();
+    return pmm_alloc_pages(1);
+}
+
+void pmm_free_page(uint64_t page_addr) {
+    pmm_free_pages(page_addr, 1);
+}
+
+uint64_t pmm_alloc_pages(size_t count) {
+    return pmm_alloc_pages_type(count, PG_KERNEL);
+}
+
+uint64_t pmm_alloc_pages_type(size_t count, uint32_t type) {
+    return pmm_alloc_pages_zone(count, ZONE_NORMAL, type);
+}
+
+// Helper: Allocate 2^order pages from one zone's regions
+static uint64_t zone_alloc(pmm_zone_t* zone, uint32_t order, size_t count, uint32_t type) {
+    // Start at the hint and wrap around, so exhausted regions in front
+    // of it are not probed on every call
+    uint32_t candidates = region_free_mask & zone->region_mask;
+    while (candidates) {
+        uint32_t ahead = candidates & (~0u << zone->alloc_hint);
+        int i = __builtin_ctz(ahead ? ahead : candidates);
+        candidates &= ~(1u << i);
+        
+        pmm_region_t* region = &regions[i];
+        uint64_t start_page = buddy_alloc(region, order, type);
+        if (start_page == 0) continue;
+        
+        // Give back the tail the caller did not ask for
+        if (count < (1ULL << order)) {
+            buddy_free_range(region, start_page + count, (1ULL << order) - count);
+        }
+        
+        zone->alloc_hint = i;
+        return start_page * PAGE_SIZE;
+    }
+    
+    return 0;
+}
+
+// Helper: Reduce a type argument to one allocated PG_* type plus
+// PG_MOVABLE, or 0 when it does not name exactly one type
+static uint32_t alloc_type(uint32_t type) {
+    uint32_t base = type & PG_TYPE_MASK & ~PG_FREE;
+    if (base == 0 || (base & (base - 1)) != 0) {
+        return 0;
+    }
+    return base | (type & PG_MOVABLE);
+}
+
+// Helper: Allocate a 2^order block trimmed to count pages
+static uint64_t alloc_order(size_t count, uint32_t order, int zone, uint32_t type) {
+    // Start at the highest zone that has memory at all: with less than
+    // 4 GiB (or before pmm_online_regions) ZONE_NORMAL is empty, and DMA32
+    // is then the general zone, not a reserve to fall back on
+    int top = zone;
+    while (top > 0 && zones[top].total_pages == 0) {
+        top--;
+    }
+    
+    // Highest zone first; lower zones only lend pages above their low
+    // watermark so DMA-capable memory is left for those who need it
+    for (int z = top; z >= 0; z--) {
+        if (z < top && zones[z].free_pages < zones[z].low_pages + (1ULL << order)) {
+            continue;
+        }
+        
+        uint64_t addr = zone_alloc(&zones[z], order, count, type);
+        if (addr) {
+            return addr;
+        }
+    }
     
-    if (page == -1) {
-        return 0;  // Out of memory
+    // The zeroed page pool is only a cache: give it back and retry
+    if (zero_pool_count > 0) {
+        while (zero_pool_count > 0) {
+            pmm_free_page(zero_pool[--zero_pool_count]);
+        }
+        return alloc_order(count, order, zone, type);
     }
     
-    bitmap_set(page);
-    used_blocks++;
+    return 0;  // Not enough contiguous pages
+}
+
+uint64_t pmm_alloc_pages_zone(size_t count, int zone, uint32_t type) {
+    if (count == 0 || zone < 0 || zone >= PMM_ZONES) return 0;
+    
+    type = alloc_type(type);
+    if (!type) return 0;
     
-    return (uint64_t)page * PAGE_SIZE;
+    uint32_t order = order_for_count(count);
+    if (order > PMM_MAX_ORDER) {
+        return 0;  // Larger than the biggest buddy block
+    }
+    
+    return alloc_order(count, order, zone, type);
 }
 
-void pmm_free_page(uint64_t page_addr) {
-    if (page_addr == 0) return;
+uint64_t pmm_alloc_pages_aligned(size_t count, size_t align) {
+    return pmm_alloc_pages_aligned_type(count, align, PG_KERNEL);
+}
+
+uint64_t pmm_alloc_pages_aligned_type(size_t count, size_t align, uint32_t type) {
+    if (count == 0 || align < PAGE_SIZE || (align & (align - 1)) != 0) return 0;
+    
+    type = alloc_type(type);
+    if (!type) return 0;
     
-    uint32_t page = page_addr / PAGE_SIZE;
+    // Buddy blocks are aligned to their own size, so a block at least as
+    // large as the alignment is all it takes
+    uint32_t order = order_for_count(count);
+    uint32_t align_order = __builtin_ctzll(align / PAGE_SIZE);
+    if (align_order > order) {
+        order = align_order;
+    }
+    if (order > PMM_MAX_ORDER) {
+        return 0;
+    }
     
-    if (bitmap_test(page)) {
-        bitmap_clear(page);
-        used_blocks--;
+    uint64_t addr = alloc_order(count, order, ZONE_NORMAL, type);
+    if (!addr && pmm_compact(order) == 0) {
+        addr = alloc_order(count, order, ZONE_NORMAL, type);
     }
+    return addr;
 }
 
-uint64_t pmm_alloc_pages(size_t count) {
-    if (count == 0) return 0;
+uint64_t pmm_alloc_zeroed_page(void) {
+    return pmm_alloc_zeroed_page_type(PG_KERNEL);
+}
+
+uint64_t pmm_alloc_zeroed_page_type(uint32_t type) {
+    type = alloc_type(type);
+    if (!type) return 0;
     
-    int start_page = find_free_pages(count);
+    if (zero_pool_count > 0) {
+        uint64_t addr = zero_pool[--zero_pool_count];
+        uint64_t pfn = addr / PAGE_SIZE;
+        page_set_range(pfn_to_region(pfn), pfn, 1, type);
+        zero_pool_hits++;
+        return addr;
+    }
     
-    if (start_page == -1) {
-        return 0;  // Not enough contiguous pages
+    uint64_t addr = pmm_alloc_pages_type(1, type);
+    if (addr) {
+        zero_page(addr);
+        zero_pool_misses++;
     }
+    return addr;
+}
+
+int pmm_idle_zero(void) {
+    int added = 0;
     
-    // Mark all pages as used
-    for (size_t i = 0; i < count; i++) {
-        bitmap_set(start_page + i);
-        used_blocks++;
+    for (int i = 0; i < PMM_ZERO_BATCH && zero_pool_count < PMM_ZERO_POOL_PAGES; i++) {
+        uint64_t addr = pmm_alloc_page();
+        if (!addr) break;
+        
+        // Don't hold memory back from a zone that is already short
+        pmm_zone_t* zone = &zones[pmm_get_page(addr)->zone];
+        if (zone->free_pages < zone->high_pages) {
+            pmm_free_page(addr);
+            break;
+        }
+        
+        zero_page(addr);
+        zero_pool[zero_pool_count++] = addr;
+        added++;
     }
     
-    return (uint64_t)start_page * PAGE_SIZE;
+    // Worth calling again only if this batch filled up and room is left
+    return added == PMM_ZERO_BATCH && zero_pool_count < PMM_ZERO_POOL_PAGES;
 }
 
 void pmm_free_pages(uint64_t page_addr, size_t count) {
     if (page_addr == 0 || count == 0) return;
     
-    uint32_t start_page = page_addr / PAGE_SIZE;
+    uint64_t pfn = page_addr / PAGE_SIZE;
+    pmm_region_t* region = pfn_to_region(pfn);
+    if (!region) return;
+    
+    uint64_t end = pfn + count;
+    if (end > region->base + region->pages) {
+        end = region->base + region->pages;
+    }
+    
+    // Shared pages only lose a reference; release the runs between them
+    uint64_t run = pfn;
+    for (uint64_t page = pfn; page < end; page++) {
+        struct page* meta = region_page(region, page);
+        if (meta->refcount > 1) {
+            meta->refcount--;
+            if (page > run) {
+                buddy_free_range(region, run, page - run);
+            }
+            run = page + 1;
+        }
+    }
+    if (end > run) {
+        buddy_free_range(region, run, end - run);
+    }
+}
+
+struct page* pmm_get_page(uint64_t page_addr) {
+    uint64_t pfn = page_addr / PAGE_SIZE;
+    pmm_region_t* region = pfn_to_region(pfn);
+    
+    return region ? region_page(region, pfn) : NULL;
+}
+
+uint64_t pmm_page_to_phys(struct page* page) {
+    for (int i = 0; i < region_count; i++) {
+        pmm_region_t* region = &regions[i];
+        if (region->online && page >= region->page_db &&
+            page < region->page_db + region->pages) {
+            return (region->base + (page - region->page_db)) * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+void pmm_page_ref(uint64_t page_addr) {
+    struct page* page = pmm_get_page(page_addr);
+    
+    if (page && page->refcount > 0) {
+        page->refcount++;
+    }
+}
+
+// Compaction
+// A window of 2^order pages can be emptied when every used page in it is
+// PG_MOVABLE, unshared and of a type with a migrate handler. Its free
+// blocks are taken off the lists first so the copies land elsewhere, then
+// each used page is copied out and its owner remaps it.
+
+// Helper: Pages that have to move to empty a window, or -1 if one can't
+static int64_t window_cost(pmm_region_t* region, uint64_t pfn, uint64_t count) {
+    struct page* page = region_page(region, pfn);
+    int64_t used = 0;
+    
+    for (uint64_t i = 0; i < count; i++) {
+        if (page[i].flags & PG_FREE) continue;
+        
+        if (!(page[i].flags & PG_MOVABLE) || page[i].refcount != 1 ||
+            !migrate_handlers[type_index(page[i].flags)]) {
+            return -1;
+        }
+        used++;
+    }
+    return used;
+}
+
+// Helper: Pull a window's free blocks off the lists, holding them as used
+static void window_isolate(pmm_region_t* region, uint64_t pfn, uint64_t count) {
+    uint64_t end = pfn + count;
+    
+    while (pfn < end) {
+        struct page* page = region_page(region, pfn);
+        if (!(page->flags & PG_BUDDY)) {
+            pfn++;
+            continue;
+        }
+        
+        uint64_t pages = 1ULL << page->order;
+        free_list_remove(region, pfn_to_block(pfn));
+        bitmap_fill(region, pfn, pages, 1);
+        page_set_range(region, pfn, pages, PG_KERNEL);
+        pfn += pages;
+    }
+}
+
+// Helper: Move one page out of the window and hold its old frame
+static int migrate_page(pmm_region_t* region, uint64_t pfn) {
+    struct page* page = region_page(region, pfn);
+    uint32_t type = page->flags & (PG_TYPE_MASK | PG_MOVABLE);
+    uint64_t old_addr = pfn * PAGE_SIZE;
+    
+    uint64_t new_addr = pmm_alloc_pages_type(1, type);
+    if (!new_addr) {
+        return -1;
+    }
+    
+    copy_page(new_addr, old_addr);
+    if (migrate_handlers[type_index(type)](old_addr, new_addr) != 0) {
+        pmm_free_page(new_addr);
+        return -1;
+    }
+    
+    page_set_range(region, pfn, 1, PG_KERNEL);
+    return 0;
+}
+
+// Helper: Free every page in the window that is not still movable
+static void window_release(pmm_region_t* region, uint64_t pfn, uint64_t count) {
+    uint64_t end = pfn + count;
+    uint64_t run = pfn;
+    
+    for (uint64_t page = pfn; page < end; page++) {
+        if (region_page(region, page)->flags & PG_MOVABLE) {
+            if (page > run) {
+                buddy_free_range(region, run, page - run);
+            }
+            run = page + 1;
+        }
+    }
+    if (end > run) {
+        buddy_free_range(region, run, end - run);
+    }
+}
+
+void pmm_set_migrate_handler(uint32_t type, pmm_migrate_fn handler) {
+    if ((type & PG_TYPE_MASK) != 0) {
+        migrate_handlers[type_index(type)] = handler;
+    }
+}
+
+int pmm_compact(uint32_t order) {
+    if (order > PMM_MAX_ORDER) {
+        return -1;
+    }
+    
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].free_mask & (~0u << order)) {
+            return 0;  // Nothing to do
+        }
+    }
+    
+    // Pick the aligned window with the fewest pages to move, preferring
+    // high zones the way allocations do
+    uint64_t count = 1ULL << order;
+    pmm_region_t* best = NULL;
+    uint64_t best_pfn = 0;
+    int64_t best_cost = -1;
     
-    for (size_t i = 0; i < count; i++) {
-        if (bitmap_test(start_page + i)) {
-            bitmap_clear(start_page + i);
-            used_blocks--;
+    for (int i = 0; i < region_count; i++) {
+        pmm_region_t* region = &regions[i];
+        if (!region->online) continue;
+        
+        uint64_t pfn = (region->base + count - 1) & ~(count - 1);
+        for (; pfn + count <= region->base + region->pages; pfn += count) {
+            int64_t cost = window_cost(region, pfn, count);
+            if (cost < 0) continue;
+            if (best_cost < 0 || region->zone > best->zone ||
+                (region->zone == best->zone && cost < best_cost)) {
+                best = region;
+                best_pfn = pfn;
+                best_cost = cost;
+            }
+        }
+    }
+    
+    if (!best || (uint64_t)best_cost > pmm_get_free_memory() / PAGE_SIZE) {
+        return -1;
+    }
+    
+    window_isolate(best, best_pfn, count);
+    
+    int result = 0;
+    for (uint64_t pfn = best_pfn; pfn < best_pfn + count; pfn++) {
+        if ((region_page(best, pfn)->flags & PG_MOVABLE) && migrate_page(best, pfn) != 0) {
+            result = -1;
+            break;
         }
     }
+    
+    window_release(best, best_pfn, count);
+    return result;
 }
 
 uint64_t pmm_get_total_memory(void) {
-    return total_memory;
+    return total_pages * PAGE_SIZE;
 }
 
+// The zeroed pool is an idle cache handed back on demand: its pages are
+// PG_KERNEL in the frame database but count as neither used nor free
 uint64_t pmm_get_used_memory(void) {
-    return used_blocks * 32 * PAGE_SIZE;
+    return (total_pages - type_pages[type_index(PG_FREE)] - zero_pool_count) * PAGE_SIZE;
 }
 
 uint64_t pmm_get_free_memory(void) {
-    return total_memory - pmm_get_used_memory();
+    return type_pages[type_index(PG_FREE)] * PAGE_SIZE;
+}
+
+uint64_t pmm_get_largest_free_block(void) {
+    int largest = -1;
+    
+    for (int i = 0; i < region_count; i++) {
+        if (!regions[i].online || !regions[i].free_mask) continue;
+        int order = 31 - __builtin_clz(regions[i].free_mask);
+        if (order > largest) {
+            largest = order;
+        }
+    }
+    
+    return (largest < 0) ? 0 : (1ULL << largest) * PAGE_SIZE;
+}
+
+int pmm_get_zone_info(int zone, pmm_zone_info_t* info) {
+    if (zone < 0 || zone >= PMM_ZONES) {
+        return -1;
+    }
+    info->name = zones[zone].name;
+    info->total_pages = zones[zone].total_pages;
+    info->free_pages = zones[zone].free_pages;
+    info->low_pages = zones[zone].low_pages;
+    info->high_pages = zones[zone].high_pages;
+    return 0;
+}
+
+void pmm_get_zero_pool_info(pmm_zero_pool_info_t* info) {
+    info->pages = zero_pool_count;
+    info->hits = zero_pool_hits;
+    info->misses = zero_pool_misses;
+}
+
+uint64_t pmm_get_type_memory(uint32_t type) {
+    if ((type & PG_TYPE_MASK) == 0) {
+        return 0;
+    }
+    if (type_index(type) == type_index(PG_KERNEL)) {
+        return (type_pages[type_index(PG_KERNEL)] - zero_pool_count) * PAGE_SIZE;
+    }
+    return type_pages[type_index(type)] * PAGE_SIZE;
 }
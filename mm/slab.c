@@ -0,0 +1,288 @@
+#include <mm/slab.h>
+#include <mm/pmm.h>
+#include <mm/memlayout.h>
+#include <lib/string/string.h>
+#include <ui/console.h>
+
+#define SLAB_MAX_CACHES  32
+#define SLAB_MIN_OBJECTS 8      // Grow slabs until at least this many fit
+#define SLAB_MAX_PAGES   8
+#define SLAB_KEEP_EMPTY  1      // Empty slabs kept per cache before release
+#define CACHE_LINE_SIZE  64
+
+// A slab is a naturally aligned run of PMM pages. This header sits at the
+// start, so the owning slab of any object is found by masking its address.
+//
+// Build with -DSLAB_DEBUG to halt on a freed object that is freed again.
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    kmem_cache_t* cache;
+    void* free;             // First free object
+    uint32_t inuse;
+} slab_t;
+
+struct kmem_cache {
+    char name[SLAB_NAME_LEN];
+    size_t object_size;
+    size_t stride;
+    size_t free_offset;     // Where a free object keeps its next pointer
+    size_t header;          // Slab header rounded up to the alignment
+    size_t colour_step;
+    uint32_t colours;       // Distinct first-object offsets
+    uint32_t colour_next;
+    uint32_t slab_pages;
+    uint32_t objects_per_slab;
+    void (*ctor)(void* obj);
+    
+    // Slabs by state
+    slab_t* partial;
+    slab_t* full;
+    slab_t* empty;
+    uint32_t slabs;
+    uint32_t empty_slabs;
+    
+    uint64_t active_objects;
+    uint64_t allocs;
+    uint64_t frees;
+    int used;
+};
+
+static kmem_cache_t caches[SLAB_MAX_CACHES];
+
+// Helper: Round up to a power-of-two alignment
+static inline size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline void** free_ptr(kmem_cache_t* cache, void* obj) {
+    return (void**)((uint8_t*)obj + cache->free_offset);
+}
+
+#ifdef SLAB_DEBUG
+static void slab_debug_fail(kmem_cache_t* cache, const char* reason) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+    console_write("\n[SLAB] ");
+    console_write(cache->name);
+    console_write(": ");
+    console_write(reason);
+    console_write("\nSystem halted!\n");
+    while (1) __asm__ volatile("cli; hlt");
+}
+#endif
+
+static void slab_list_add(slab_t** head, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_remove(slab_t** head, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+// Helper: Allocate and format a new slab, constructing its objects
+static slab_t* cache_grow(kmem_cache_t* cache) {
+    size_t bytes = (size_t)cache->slab_pages * PAGE_SIZE;
+    uint64_t phys = pmm_alloc_pages_aligned_type(cache->slab_pages, bytes, PG_SLAB);
+    if (!phys) {
+        return NULL;
+    }
+    
+    slab_t* slab = (slab_t*)phys_to_virt(phys);
+    
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+    
+    // Colouring: start each slab at a different cache line so the same
+    // object index in different slabs does not compete for the same sets
+    uint8_t* first = (uint8_t*)slab + cache->header + cache->colour_next * cache->colour_step;
+    cache->colour_next = (cache->colour_next + 1) % cache->colours;
+    
+    for (uint32_t i = cache->objects_per_slab; i > 0; i--) {
+        void* obj = first + (i - 1) * cache->stride;
+        if (cache->ctor) {
+            cache->ctor(obj);
+        }
+        *free_ptr(cache, obj) = slab->free;
+        slab->free = obj;
+    }
+    
+    cache->slabs++;
+    return slab;
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align,
+                                void (*ctor)(void* obj)) {
+    if (size == 0 || (align & (align - 1)) != 0) {
+        return NULL;
+    }
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    
+    kmem_cache_t* cache = NULL;
+    for (int i = 0; i < SLAB_MAX_CACHES; i++) {
+        if (!caches[i].used) {
+            cache = &caches[i];
+            break;
+        }
+    }
+    if (!cache) {
+        return NULL;
+    }
+    
+    memset(cache, 0, sizeof(*cache));
+    strncpy(cache->name, name, SLAB_NAME_LEN - 1);
+    cache->object_size = size;
+    cache->ctor = ctor;
+    
+    // A constructed object must keep its contents while free, so the
+    // free list pointer goes after it instead of over its first word
+    if (ctor) {
+        cache->free_offset = align_up(size, sizeof(void*));
+        cache->stride = align_up(cache->free_offset + sizeof(void*), align);
+    } else {
+        cache->free_offset = 0;
+        cache->stride = align_up(size < sizeof(void*) ? sizeof(void*) : size, align);
+    }
+    
+    cache->header = align_up(sizeof(slab_t), align);
+    cache->slab_pages = 1;
+    while (cache->slab_pages < SLAB_MAX_PAGES &&
+           (cache->slab_pages * PAGE_SIZE - cache->header) / cache->stride < SLAB_MIN_OBJECTS) {
+        cache->slab_pages *= 2;
+    }
+    
+    size_t usable = cache->slab_pages * PAGE_SIZE - cache->header;
+    cache->objects_per_slab = usable / cache->stride;
+    if (cache->objects_per_slab == 0) {
+        return NULL;  // Too large for a slab
+    }
+    
+    cache->colour_step = (align > CACHE_LINE_SIZE) ? align : CACHE_LINE_SIZE;
+    cache->colours = (usable - cache->objects_per_slab * cache->stride) / cache->colour_step + 1;
+    cache->used = 1;
+    
+    return cache;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (!cache) {
+        return NULL;
+    }
+    
+    slab_t* slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+            cache->empty_slabs--;
+        } else {
+            slab = cache_grow(cache);
+            if (!slab) {
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+    
+    void* obj = slab->free;
+    slab->free = *free_ptr(cache, obj);
+    slab->inuse++;
+    
+    if (slab->inuse == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    
+    cache->active_objects++;
+    cache->allocs++;
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!cache || !obj) {
+        return;
+    }
+    
+    uintptr_t mask = (uintptr_t)cache->slab_pages * PAGE_SIZE - 1;
+    slab_t* slab = (slab_t*)((uintptr_t)obj & ~mask);
+    if (slab->cache != cache) {
+        return;  // Not ours
+    }
+    
+    // Nothing allocated from this slab: the object was freed already, and
+    // the slab sits on the empty list where the unlinks below would wreck it
+    if (slab->inuse == 0) {
+#ifdef SLAB_DEBUG
+        slab_debug_fail(cache, "free into an empty slab");
+#endif
+        return;
+    }
+    
+#ifdef SLAB_DEBUG
+    for (void* free = slab->free; free; free = *free_ptr(cache, free)) {
+        if (free == obj) {
+            slab_debug_fail(cache, "double free");
+        }
+    }
+#endif
+    
+    if (slab->inuse == cache->objects_per_slab) {
+        slab_list_remove(&cache->full, slab);
+    } else {
+        slab_list_remove(&cache->partial, slab);
+    }
+    
+    *free_ptr(cache, obj) = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+    cache->active_objects--;
+    cache->frees++;
+    
+    if (slab->inuse > 0) {
+        slab_list_add(&cache->partial, slab);
+    } else if (cache->empty_slabs < SLAB_KEEP_EMPTY) {
+        slab_list_add(&cache->empty, slab);
+        cache->empty_slabs++;
+    } else {
+        slab->cache = NULL;
+        cache->slabs--;
+        pmm_free_pages(virt_to_phys(slab), cache->slab_pages);
+    }
+}
+
+int kmem_cache_get_info(int index, kmem_cache_info_t* info) {
+    int seen = 0;
+    
+    for (int i = 0; i < SLAB_MAX_CACHES; i++) {
+        if (!caches[i].used) continue;
+        if (seen++ != index) continue;
+        
+        kmem_cache_t* cache = &caches[i];
+        info->name = cache->name;
+        info->object_size = cache->object_size;
+        info->stride = cache->stride;
+        info->slab_pages = cache->slab_pages;
+        info->objects_per_slab = cache->objects_per_slab;
+        info->slabs = cache->slabs;
+        info->active_objects = cache->active_objects;
+        info->allocs = cache->allocs;
+        info->frees = cache->frees;
+        return 0;
+    }
+    
+    return -1;
+}
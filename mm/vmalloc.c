@@ -0,0 +1,147 @@
+#include <mm/vmalloc.h>
+#include <mm/vmm.h>
+#include <mm/pmm.h>
+
+// An area is a run of pages in [VMALLOC_BASE, VMALLOC_LIMIT) followed by
+// an unmapped guard page, so running off the end faults instead of
+// corrupting the next area. Areas are kept sorted by address and new ones
+// go in the first gap that fits.
+typedef struct {
+    uint64_t start;
+    size_t pages;
+    int lazy;
+} vmalloc_area_t;
+
+static vmalloc_area_t areas[VMALLOC_AREAS];
+static uint32_t area_count = 0;
+
+// Helper: Find room for pages (plus guard) and record the area there
+static vmalloc_area_t* area_alloc(size_t pages, int lazy) {
+    if (area_count == VMALLOC_AREAS) {
+        return NULL;
+    }
+    
+    uint64_t span = (pages + 1) * PAGE_SIZE;
+    uint64_t start = VMALLOC_BASE;
+    uint32_t index = 0;
+    
+    for (; index < area_count; index++) {
+        if (areas[index].start - start >= span) {
+            break;
+        }
+        start = areas[index].start + (areas[index].pages + 1) * PAGE_SIZE;
+    }
+    if (start + span > VMALLOC_LIMIT) {
+        return NULL;
+    }
+    
+    for (uint32_t i = area_count; i > index; i--) {
+        areas[i] = areas[i - 1];
+    }
+    area_count++;
+    
+    areas[index].start = start;
+    areas[index].pages = pages;
+    areas[index].lazy = lazy;
+    return &areas[index];
+}
+
+static void area_remove(vmalloc_area_t* area) {
+    uint32_t index = area - areas;
+    for (uint32_t i = index; i + 1 < area_count; i++) {
+        areas[i] = areas[i + 1];
+    }
+    area_count--;
+}
+
+// Helper: Unmap the pages of an area that are mapped and free them
+static void area_unmap(vmalloc_area_t* area) {
+    vmm_batch_begin();
+    for (size_t i = 0; i < area->pages; i++) {
+        uint64_t virt = area->start + i * PAGE_SIZE;
+        uint64_t phys = vmm_get_physical_address(virt);
+        if (!phys) continue;
+        
+        vmm_unmap_page(virt);
+        pmm_free_page(phys);
+    }
+    vmm_batch_end();
+}
+
+void* vmalloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    vmalloc_area_t* area = area_alloc(pages, 0);
+    if (!area) {
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < pages; i++) {
+        uint64_t phys = pmm_alloc_page();
+        if (!phys || vmm_map_page(area->start + i * PAGE_SIZE, phys,
+                                  PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+            if (phys) {
+                pmm_free_page(phys);
+            }
+            area_unmap(area);
+            area_remove(area);
+            return NULL;
+        }
+    }
+    
+    return (void*)area->start;
+}
+
+void* vmalloc_lazy(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    vmalloc_area_t* area = area_alloc(pages, 1);
+    if (!area) {
+        return NULL;
+    }
+    
+    if (vmm_add_lazy_region(area->start, pages * PAGE_SIZE, PAGE_WRITABLE, PG_KERNEL) != 0) {
+        area_remove(area);
+        return NULL;
+    }
+    return (void*)area->start;
+}
+
+void vfree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < area_count; i++) {
+        if (areas[i].start != (uint64_t)ptr) continue;
+        
+        // Stop faulting pages in before taking the mapped ones away
+        if (areas[i].lazy) {
+            vmm_remove_lazy_region(areas[i].start);
+        }
+        area_unmap(&areas[i]);
+        area_remove(&areas[i]);
+        return;
+    }
+}
+
+void vmalloc_get_info(vmalloc_info_t* info) {
+    info->areas = area_count;
+    info->reserved_bytes = 0;
+    info->mapped_bytes = 0;
+    
+    for (uint32_t i = 0; i < area_count; i++) {
+        info->reserved_bytes += areas[i].pages * PAGE_SIZE;
+        for (size_t page = 0; page < areas[i].pages; page++) {
+            if (vmm_get_physical_address(areas[i].start + page * PAGE_SIZE)) {
+                info->mapped_bytes += PAGE_SIZE;
+            }
+        }
+    }
+}
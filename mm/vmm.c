@@ -1,30 +1,246 @@
 #include <mm/vmm.h>
 #include <mm/pmm.h>
+#include <arch/x86_64/cpu.h>
 #include <ui/console.h>
+#include <lib/string/string.h>
+
+#define CPUID_EXT_PDPE1GB (1 << 26)  // 0x80000001 EDX: 1 GiB pages
+#define CPUID_PGE         (1 << 13)  // 0x1 EDX: global pages
+#define CPUID_PCID        (1 << 17)  // 0x1 ECX: process-context identifiers
+#define CPUID_PAT         (1 << 16)  // 0x1 EDX: page attribute table
+
+// PAT entries: the power-on defaults (WB, WT, UC-, UC) twice, except that
+// PA4 is write-combining. Nothing else sets the PAT bit, so PA4 is only
+// reached through PAGE_WRITE_COMBINING.
+#define MSR_PAT   0x277
+#define PAT_VALUE 0x0007040100070406ULL
+
+#define CR4_PGE     (1 << 7)
+#define CR4_PCIDE   (1 << 17)
+#define CR3_NOFLUSH (1ULL << 63)    // Keep the PCID's entries on this load
 
 // Kernel PML4 (Page Map Level 4 - top level page table)
 static page_table_t* kernel_pml4 = NULL;
 
+static int huge_pages = 0;      // CPU supports 1 GiB pages
+static int pat_enabled = 0;
+
+static uint32_t tlb_supported = 0;
+static uint32_t tlb_features = 0;
+static uint64_t current_pml4 = 0;   // Physical address loaded in CR3
+
+// PCID owners by PML4 physical address (0 = free). An address space gets
+// a PCID on its first switch, taking the next one round robin when all
+// are in use; the load that hands a PCID to a new owner flushes it.
+static uint64_t pcid_owner[VMM_PCIDS];
+static uint32_t pcid_next = 0;
+
+// Demand-zero regions
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t flags;
+    uint32_t type;
+    int used;
+} lazy_region_t;
+
+static lazy_region_t lazy_regions[VMM_LAZY_REGIONS];
+static uint64_t demand_faults = 0;
+
+// Pending invalidations while a batch is open. Past the threshold the
+// addresses are no longer stored and vmm_batch_end reloads CR3 instead.
+static uint32_t batch_depth = 0;
+static uint32_t batch_count = 0;
+static uint64_t batch_pages[VMM_BATCH_MAX];
+static uint32_t flush_threshold = VMM_FLUSH_THRESHOLD;
+static vmm_flush_info_t flush_info;
+
+static inline uint64_t read_cr4(void) {
+    uint64_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+static inline void write_cr4(uint64_t cr4) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+static inline void write_cr3(uint64_t cr3) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+// Helper: Drop the whole TLB. A CR3 load keeps global entries, toggling
+// CR4.PGE doesn't (and clears every PCID as well).
+static void flush_tlb_all(void) {
+    if (tlb_features & VMM_TLB_GLOBAL) {
+        uint64_t cr4 = read_cr4();
+        write_cr4(cr4 & ~(uint64_t)CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        uint64_t cr3;
+        __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+        write_cr3(cr3);
+    }
+    flush_info.full_flushes++;
+}
+
+// Helper: Invalidate the TLB entry for virt_addr, now or at batch end
+static void flush_page(uint64_t virt_addr) {
+    if (batch_depth == 0) {
+        __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+        flush_info.page_flushes++;
+        return;
+    }
+    
+    if (batch_count < flush_threshold) {
+        batch_pages[batch_count] = virt_addr;
+    }
+    batch_count++;
+}
+
+// Helper: Rewrite a leaf entry. The TLB never caches a not-present
+// entry, so only a translation that was live needs flushing.
+static void set_entry(uint64_t* entry, uint64_t value, uint64_t virt_addr) {
+    uint64_t old = *entry;
+    *entry = value;
+    
+    if (old & PAGE_PRESENT) {
+        flush_page(virt_addr);
+    } else {
+        flush_info.skipped++;
+    }
+}
+
+// Helper: Table an entry points to, through the direct map
+static inline page_table_t* entry_table(uint64_t entry) {
+    return (page_table_t*)phys_to_virt(entry & ~0xFFFULL);
+}
+
+// Helper: Replace a 2 MiB or 1 GiB entry with a table of the next smaller
+// pages covering the same memory. The translations don't change, so no
+// flush is needed until one of the new entries is modified.
+static int split_entry(uint64_t* entry, uint64_t entry_size) {
+    uint64_t phys_addr = pmm_alloc_pages_type(1, PG_PAGETABLE);
+    if (!phys_addr) {
+        return -1;
+    }
+    
+    page_table_t* table = (page_table_t*)phys_to_virt(phys_addr);
+    uint64_t step = entry_size / 512;
+    uint64_t base = *entry & ~(entry_size - 1);
+    uint64_t flags = *entry & 0xFFF & ~(uint64_t)PAGE_HUGE;
+    
+    // The PAT bit is bit 12 in a large entry but bit 7 in a 4 KiB one
+    uint64_t pat = *entry & PAGE_PAT_LARGE;
+    base &= ~(uint64_t)PAGE_PAT_LARGE;
+    if (step > PAGE_SIZE) {
+        flags |= PAGE_HUGE | pat;
+    } else if (pat) {
+        flags |= PAGE_PAT;
+    }
+    
+    for (int i = 0; i < 512; i++) {
+        table->entries[i] = (base + i * step) | flags;
+    }
+    *entry = phys_addr | PAGE_PRESENT | PAGE_WRITABLE;
+    return 0;
+}
+
+// Helper: Entry flags for a page_size mapping at virt_addr. Upper half
+// mappings are the same in every address space, so they are global.
+static inline uint64_t leaf_flags(uint64_t virt_addr, uint64_t flags, uint64_t page_size) {
+    if (virt_addr >= DIRECT_MAP_BASE) {
+        flags |= PAGE_GLOBAL;
+    }
+    if (flags & PAGE_WRITE_COMBINING) {
+        flags &= ~(uint64_t)PAGE_WRITE_COMBINING;
+        if (pat_enabled) {
+            flags &= ~(uint64_t)(PAGE_WRITETHROUGH | PAGE_CACHE_DISABLE);
+            flags |= (page_size == PAGE_SIZE) ? PAGE_PAT : PAGE_PAT_LARGE;
+        }
+    }
+    if (page_size != PAGE_SIZE) {
+        flags |= PAGE_HUGE;
+    }
+    return flags;
+}
+
+// Helper: PCID to load pml4_phys with, plus CR3_NOFLUSH while the PCID
+// still belongs to it
+static uint64_t pcid_get(uint64_t pml4_phys) {
+    int free_pcid = -1;
+    for (uint32_t i = 0; i < VMM_PCIDS; i++) {
+        if (pcid_owner[i] == pml4_phys) {
+            return i | CR3_NOFLUSH;
+        }
+        if (free_pcid < 0 && pcid_owner[i] == 0) {
+            free_pcid = i;
+        }
+    }
+    
+    uint32_t pcid = free_pcid;
+    if (free_pcid < 0) {
+        pcid = pcid_next;
+        if (pcid_owner[pcid] == current_pml4) {
+            pcid = (pcid + 1) % VMM_PCIDS;  // Never take the live one
+        }
+        pcid_next = (pcid + 1) % VMM_PCIDS;
+    }
+    
+    pcid_owner[pcid] = pml4_phys;
+    return pcid;
+}
+
 // Helper: Get or create page table
-static page_table_t* get_or_create_table(uint64_t* entry) {
+static page_table_t* get_or_create_table(uint64_t* entry, uint64_t entry_size) {
     if (*entry & PAGE_PRESENT) {
-        return (page_table_t*)(*entry & ~0xFFF);
+        if ((*entry & PAGE_HUGE) && split_entry(entry, entry_size) != 0) {
+            return NULL;
+        }
+        return entry_table(*entry);
     }
     
-    // Allocate new page table
-    uint64_t phys_addr = pmm_alloc_page();
+    // Allocate new page table (comes back cleared)
+    uint64_t phys_addr = pmm_alloc_zeroed_page_type(PG_PAGETABLE);
     if (!phys_addr) {
         return NULL;
     }
     
-    // Clear the new table
-    page_table_t* table = (page_table_t*)phys_addr;
-    for (int i = 0; i < 512; i++) {
-        table->entries[i] = 0;
+    *entry = phys_addr | PAGE_PRESENT | PAGE_WRITABLE;
+    return entry_table(*entry);
+}
+
+// Helper: Entry that maps virt_addr with page_size pages (PAGE_SIZE,
+// LARGE_PAGE_SIZE or HUGE_PAGE_SIZE), creating tables and splitting
+// larger pages on the way down. NULL when out of memory.
+static uint64_t* get_entry(uint64_t virt_addr, uint64_t page_size) {
+    page_table_t* table = kernel_pml4;
+    
+    for (int shift = 39; ; shift -= 9) {
+        uint64_t* entry = &table->entries[(virt_addr >> shift) & 0x1FF];
+        uint64_t entry_size = 1ULL << shift;
+        if (entry_size == page_size) {
+            return entry;
+        }
+        
+        table = get_or_create_table(entry, entry_size);
+        if (!table) {
+            return NULL;
+        }
     }
+}
+
+// Helper: Largest page size usable at virt_addr/phys_addr for the rest
+static uint64_t pick_page_size(uint64_t virt_addr, uint64_t phys_addr, uint64_t remaining) {
+    uint64_t both = virt_addr | phys_addr;
     
-    *entry = phys_addr | PAGE_PRESENT | PAGE_WRITABLE;
-    return table;
+    if (huge_pages && (both & (HUGE_PAGE_SIZE - 1)) == 0 && remaining >= HUGE_PAGE_SIZE) {
+        return HUGE_PAGE_SIZE;
+    }
+    if ((both & (LARGE_PAGE_SIZE - 1)) == 0 && remaining >= LARGE_PAGE_SIZE) {
+        return LARGE_PAGE_SIZE;
+    }
+    return PAGE_SIZE;
 }
 
 void vmm_init(void) {
@@ -32,82 +248,257 @@ void vmm_init(void) {
     console_write("[VMM] Virtual Memory Manager initialized\n");
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
     
-    // Allocate kernel PML4
-    uint64_t pml4_phys = pmm_alloc_page();
-    if (!pml4_phys) {
-        console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
-        console_write("[VMM] ERROR: Failed to allocate PML4!\n");
-        return;
+    // Take over the live page tables built by boot.asm
+    uint64_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    kernel_pml4 = entry_table(cr3);
+    
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    huge_pages = (edx & CPUID_EXT_PDPE1GB) != 0;
+    
+    // The boot direct map covers 0-4 GiB; extend it over RAM above that
+    uint64_t mapped_mb = 0;
+    uint64_t base, length;
+    for (int i = 0; pmm_get_region(i, &base, &length) == 0; i++) {
+        if (base + length <= PMM_BOOT_MAP_LIMIT) continue;
+        
+        if (base < PMM_BOOT_MAP_LIMIT) {
+            length -= PMM_BOOT_MAP_LIMIT - base;
+            base = PMM_BOOT_MAP_LIMIT;
+        }
+        
+        // Round out to 2 MiB so the edges don't need 4 KiB tables
+        uint64_t start = base & ~(uint64_t)(LARGE_PAGE_SIZE - 1);
+        uint64_t end = (base + length + LARGE_PAGE_SIZE - 1) & ~(uint64_t)(LARGE_PAGE_SIZE - 1);
+        if (vmm_map_range((uint64_t)phys_to_virt(start), start, end - start,
+                          PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+            console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+            console_write("[VMM] ERROR: Failed to map high memory!\n");
+            console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+            return;
+        }
+        mapped_mb += length / (1024 * 1024);
     }
     
-    kernel_pml4 = (page_table_t*)pml4_phys;
+    // Everything runs through the higher half now: drop the boot identity map
+    kernel_pml4->entries[0] = 0;
+    write_cr3(cr3);
+    current_pml4 = cr3 & ~0xFFFULL;
     
-    // Clear PML4
-    for (int i = 0; i < 512; i++) {
-        kernel_pml4->entries[i] = 0;
+    // Kernel mappings carry PAGE_GLOBAL. The identity map shared the boot
+    // entries, so PGE only goes on now that the reload above dropped it.
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (edx & CPUID_PGE) {
+        tlb_supported |= VMM_TLB_GLOBAL;
+    }
+    if (ecx & CPUID_PCID) {
+        tlb_supported |= VMM_TLB_PCID;
     }
+    vmm_set_tlb_features(tlb_supported);
     
-    // Identity map first 16MB (kernel space)
-    for (uint64_t addr = 0; addr < 16 * 1024 * 1024; addr += PAGE_SIZE) {
-        vmm_map_page(addr, addr, PAGE_PRESENT | PAGE_WRITABLE);
+    // No mapping uses PA4 yet, so changing it needs no flush
+    if (edx & CPUID_PAT) {
+        wrmsr(MSR_PAT, PAT_VALUE);
+        pat_enabled = 1;
     }
     
-    console_write("[VMM] Identity mapped first 16MB\n");
+    // Now the PMM can build its metadata in those regions
+    pmm_online_regions();
+    
+    if (mapped_mb) {
+        console_write("[VMM] Direct mapped ");
+        console_write_dec(mapped_mb);
+        console_write(huge_pages ? " MB above 4 GiB (1 GiB pages)\n" : " MB above 4 GiB\n");
+    }
+    if (tlb_features) {
+        console_write((tlb_features & VMM_TLB_PCID) ? "[VMM] TLB: global pages, PCID\n"
+                                                    : "[VMM] TLB: global pages\n");
+    }
 }
 
 int vmm_map_page(uint64_t virt_addr, uint64_t phys_addr, uint64_t flags) {
     if (!kernel_pml4) return -1;
     
-    // Extract page table indices from virtual address
-    uint64_t pml4_index = (virt_addr >> 39) & 0x1FF;
-    uint64_t pdp_index  = (virt_addr >> 30) & 0x1FF;
-    uint64_t pd_index   = (virt_addr >> 21) & 0x1FF;
-    uint64_t pt_index   = (virt_addr >> 12) & 0x1FF;
-    
-    // Get or create PDPT (Page Directory Pointer Table)
-    page_table_t* pdpt = get_or_create_table(&kernel_pml4->entries[pml4_index]);
-    if (!pdpt) return -1;
-    
-    // Get or create PD (Page Directory)
-    page_table_t* pd = get_or_create_table(&pdpt->entries[pdp_index]);
-    if (!pd) return -1;
+    uint64_t* entry = get_entry(virt_addr, PAGE_SIZE);
+    if (!entry) return -1;
     
-    // Get or create PT (Page Table)
-    page_table_t* pt = get_or_create_table(&pd->entries[pd_index]);
-    if (!pt) return -1;
+    set_entry(entry, (phys_addr & ~0xFFF) | leaf_flags(virt_addr, flags, PAGE_SIZE), virt_addr);
+    return 0;
+}
+
+int vmm_map_range(uint64_t virt_addr, uint64_t phys_addr, uint64_t length, uint64_t flags) {
+    if (!kernel_pml4) return -1;
+    if ((virt_addr | phys_addr | length) & (PAGE_SIZE - 1)) return -1;
     
-    // Map the page
-    pt->entries[pt_index] = (phys_addr & ~0xFFF) | flags;
+    int result = 0;
+    vmm_batch_begin();
     
-    // Flush TLB for this page
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    while (length > 0) {
+        uint64_t page_size = pick_page_size(virt_addr, phys_addr, length);
+        uint64_t* entry = get_entry(virt_addr, page_size);
+        
+        // Don't throw away a table of smaller pages: map through it instead
+        while (entry && page_size != PAGE_SIZE &&
+               (*entry & (PAGE_PRESENT | PAGE_HUGE)) == PAGE_PRESENT) {
+            page_size = (page_size == HUGE_PAGE_SIZE) ? LARGE_PAGE_SIZE : PAGE_SIZE;
+            entry = get_entry(virt_addr, page_size);
+        }
+        if (!entry) {
+            result = -1;
+            break;
+        }
+        
+        set_entry(entry, phys_addr | leaf_flags(virt_addr, flags, page_size), virt_addr);
+        
+        virt_addr += page_size;
+        phys_addr += page_size;
+        length -= page_size;
+    }
     
-    return 0;
+    vmm_batch_end();
+    return result;
 }
 
 void vmm_unmap_page(uint64_t virt_addr) {
+    vmm_unmap_range(virt_addr & ~(uint64_t)(PAGE_SIZE - 1), PAGE_SIZE);
+}
+
+void vmm_unmap_range(uint64_t virt_addr, uint64_t length) {
     if (!kernel_pml4) return;
     
-    uint64_t pml4_index = (virt_addr >> 39) & 0x1FF;
-    uint64_t pdp_index  = (virt_addr >> 30) & 0x1FF;
-    uint64_t pd_index   = (virt_addr >> 21) & 0x1FF;
-    uint64_t pt_index   = (virt_addr >> 12) & 0x1FF;
+    uint64_t end = (virt_addr + length + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    virt_addr &= ~(uint64_t)(PAGE_SIZE - 1);
     
-    // Navigate through page tables
-    if (!(kernel_pml4->entries[pml4_index] & PAGE_PRESENT)) return;
-    page_table_t* pdpt = (page_table_t*)(kernel_pml4->entries[pml4_index] & ~0xFFF);
+    vmm_batch_begin();
     
-    if (!(pdpt->entries[pdp_index] & PAGE_PRESENT)) return;
-    page_table_t* pd = (page_table_t*)(pdpt->entries[pdp_index] & ~0xFFF);
+    while (virt_addr < end) {
+        page_table_t* table = kernel_pml4;
+        uint64_t entry_size = 0;
+        
+        // Walk down to the entry mapping virt_addr
+        for (int shift = 39; shift >= 12; shift -= 9) {
+            uint64_t* entry = &table->entries[(virt_addr >> shift) & 0x1FF];
+            entry_size = 1ULL << shift;
+            uint64_t entry_base = virt_addr & ~(entry_size - 1);
+            
+            if (!(*entry & PAGE_PRESENT)) {
+                break;  // Nothing mapped here, skip the whole entry
+            }
+            if (shift == 12 || (*entry & PAGE_HUGE)) {
+                if (entry_base == virt_addr && end - virt_addr >= entry_size) {
+                    set_entry(entry, 0, virt_addr);
+                    break;
+                }
+                
+                // Partly covered large page: split it and carry on below
+                if (split_entry(entry, entry_size) != 0) {
+                    vmm_batch_end();
+                    return;
+                }
+            }
+            table = entry_table(*entry);
+        }
+        
+        virt_addr = (virt_addr & ~(entry_size - 1)) + entry_size;
+    }
     
-    if (!(pd->entries[pd_index] & PAGE_PRESENT)) return;
-    page_table_t* pt = (page_table_t*)(pd->entries[pd_index] & ~0xFFF);
+    vmm_batch_end();
+}
+
+void vmm_batch_begin(void) {
+    batch_depth++;
+}
+
+void vmm_batch_end(void) {
+    if (batch_depth == 0 || --batch_depth > 0) {
+        return;
+    }
+    
+    if (batch_count > flush_threshold) {
+        flush_tlb_all();
+    } else {
+        for (uint32_t i = 0; i < batch_count; i++) {
+            __asm__ volatile("invlpg (%0)" : : "r"(batch_pages[i]) : "memory");
+        }
+        flush_info.page_flushes += batch_count;
+    }
+    batch_count = 0;
+}
+
+void vmm_set_flush_threshold(uint32_t pages) {
+    flush_threshold = (pages > VMM_BATCH_MAX) ? VMM_BATCH_MAX : pages;
+}
+
+void vmm_get_flush_info(vmm_flush_info_t* info) {
+    *info = flush_info;
+}
+
+int vmm_add_lazy_region(uint64_t start, uint64_t length, uint64_t flags, uint32_t type) {
+    if ((start | length) & (PAGE_SIZE - 1) || length == 0) return -1;
     
-    // Unmap the page
-    pt->entries[pt_index] = 0;
+    for (int i = 0; i < VMM_LAZY_REGIONS; i++) {
+        if (!lazy_regions[i].used) {
+            lazy_regions[i].start = start;
+            lazy_regions[i].end = start + length;
+            lazy_regions[i].flags = flags | PAGE_PRESENT;
+            lazy_regions[i].type = type;
+            lazy_regions[i].used = 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int vmm_resize_lazy_region(uint64_t start, uint64_t length) {
+    if (length & (PAGE_SIZE - 1) || length == 0) return -1;
     
-    // Flush TLB
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    for (int i = 0; i < VMM_LAZY_REGIONS; i++) {
+        if (lazy_regions[i].used && lazy_regions[i].start == start) {
+            lazy_regions[i].end = start + length;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void vmm_remove_lazy_region(uint64_t start) {
+    for (int i = 0; i < VMM_LAZY_REGIONS; i++) {
+        if (lazy_regions[i].used && lazy_regions[i].start == start) {
+            lazy_regions[i].used = 0;
+        }
+    }
+}
+
+int vmm_handle_page_fault(uint64_t fault_addr, uint64_t err_code) {
+    // Only a missing page can be filled in; anything else is a real fault
+    if (err_code & (PF_ERR_PRESENT | PF_ERR_RESERVED)) {
+        return -1;
+    }
+    
+    for (int i = 0; i < VMM_LAZY_REGIONS; i++) {
+        lazy_region_t* region = &lazy_regions[i];
+        if (!region->used || fault_addr < region->start || fault_addr >= region->end) {
+            continue;
+        }
+        
+        uint64_t phys = pmm_alloc_zeroed_page_type(region->type);
+        if (!phys) {
+            return -1;
+        }
+        if (vmm_map_page(fault_addr & ~(uint64_t)(PAGE_SIZE - 1), phys, region->flags) != 0) {
+            pmm_free_page(phys);
+            return -1;
+        }
+        
+        demand_faults++;
+        return 0;
+    }
+    return -1;
+}
+
+uint64_t vmm_get_demand_faults(void) {
+    return demand_faults;
 }
 
 uint64_t vmm_get_physical_address(uint64_t virt_addr) {
@@ -120,13 +511,21 @@ uint64_t vmm_get_physical_address(uint64_t virt_addr) {
     uint64_t offset     = virt_addr & 0xFFF;
     
     if (!(kernel_pml4->entries[pml4_index] & PAGE_PRESENT)) return 0;
-    page_table_t* pdpt = (page_table_t*)(kernel_pml4->entries[pml4_index] & ~0xFFF);
+    page_table_t* pdpt = entry_table(kernel_pml4->entries[pml4_index]);
     
     if (!(pdpt->entries[pdp_index] & PAGE_PRESENT)) return 0;
-    page_table_t* pd = (page_table_t*)(pdpt->entries[pdp_index] & ~0xFFF);
+    if (pdpt->entries[pdp_index] & PAGE_HUGE) {
+        return (pdpt->entries[pdp_index] & ~(uint64_t)(HUGE_PAGE_SIZE - 1)) |
+               (virt_addr & (HUGE_PAGE_SIZE - 1));
+    }
+    page_table_t* pd = entry_table(pdpt->entries[pdp_index]);
     
     if (!(pd->entries[pd_index] & PAGE_PRESENT)) return 0;
-    page_table_t* pt = (page_table_t*)(pd->entries[pd_index] & ~0xFFF);
+    if (pd->entries[pd_index] & PAGE_HUGE) {
+        return (pd->entries[pd_index] & ~(uint64_t)(LARGE_PAGE_SIZE - 1)) |
+               (virt_addr & (LARGE_PAGE_SIZE - 1));
+    }
+    page_table_t* pt = entry_table(pd->entries[pd_index]);
     
     if (!(pt->entries[pt_index] & PAGE_PRESENT)) return 0;
     
@@ -134,5 +533,90 @@ uint64_t vmm_get_physical_address(uint64_t virt_addr) {
 }
 
 void vmm_switch_page_directory(page_table_t* pml4) {
-    __asm__ volatile("mov %0, %%cr3" : : "r"(pml4) : "memory");
+    uint64_t phys = virt_to_phys(pml4);
+    uint64_t cr3 = phys;
+    
+    if (tlb_features & VMM_TLB_PCID) {
+        cr3 |= pcid_get(phys);
+    }
+    current_pml4 = phys;
+    write_cr3(cr3);
+}
+
+page_table_t* vmm_create_address_space(void) {
+    if (!kernel_pml4) return NULL;
+    
+    uint64_t phys = pmm_alloc_zeroed_page_type(PG_PAGETABLE);
+    if (!phys) {
+        return NULL;
+    }
+    
+    page_table_t* pml4 = (page_table_t*)phys_to_virt(phys);
+    for (int i = 256; i < 512; i++) {
+        pml4->entries[i] = kernel_pml4->entries[i];
+    }
+    return pml4;
+}
+
+void vmm_destroy_address_space(page_table_t* pml4) {
+    uint64_t phys = virt_to_phys(pml4);
+    if (pml4 == kernel_pml4 || phys == current_pml4) {
+        return;
+    }
+    
+    // The next owner of the PCID flushes it on its first load
+    for (uint32_t i = 0; i < VMM_PCIDS; i++) {
+        if (pcid_owner[i] == phys) {
+            pcid_owner[i] = 0;
+        }
+    }
+    pmm_free_page(phys);
+}
+
+page_table_t* vmm_get_kernel_pml4(void) {
+    return kernel_pml4;
+}
+
+uint32_t vmm_set_tlb_features(uint32_t features) {
+    features &= tlb_supported;
+    
+    // invlpg only reaches the entries of other PCIDs through the global
+    // bit, so kernel mappings have to be global once PCIDs are in use.
+    // Without PGE there are no global pages, and so no PCIDs either.
+    if (features & VMM_TLB_PCID) {
+        if (tlb_supported & VMM_TLB_GLOBAL) {
+            features |= VMM_TLB_GLOBAL;
+        } else {
+            features &= ~(uint32_t)VMM_TLB_PCID;
+        }
+    }
+    
+    uint64_t cr4 = read_cr4();
+    if ((features ^ tlb_features) & VMM_TLB_PCID) {
+        // PCIDE can only be set while CR3 holds PCID 0; everything else
+        // loses its PCID either way
+        write_cr3(current_pml4);
+        memset(pcid_owner, 0, sizeof(pcid_owner));
+        pcid_owner[0] = current_pml4;
+        pcid_next = 1;
+        
+        if (features & VMM_TLB_PCID) {
+            cr4 |= CR4_PCIDE;
+        } else {
+            cr4 &= ~(uint64_t)CR4_PCIDE;
+        }
+    }
+    if (features & VMM_TLB_GLOBAL) {
+        cr4 |= CR4_PGE;
+    } else {
+        cr4 &= ~(uint64_t)CR4_PGE;
+    }
+    write_cr4(cr4);
+    
+    tlb_features = features;
+    return features;
+}
+
+uint32_t vmm_get_tlb_features(void) {
+    return tlb_features;
 }
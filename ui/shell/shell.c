@@ -1,11 +1,19 @@
 #include <ui/shell/shell.h>
 #include <ui/shell/shell_commands.h>
 #include <ui/shell/shell_history.h>
+#include <ui/shell/shell_bench.h>
 #include <lib/string/string.h>
 #include <ui/console.h>
 #include <drivers/input/keyboard.h>
 #include <ui/tty/tty.h>
 #include <fs/vfs.h>
+#include <mm/arena.h>
+
+static arena_t* scratch_arena = NULL;
+
+arena_t* shell_scratch(void) {
+    return scratch_arena;
+}
 
 static void redraw_line_from_cursor(int tty_num) {
     tty_t* tty = &ttys[tty_num];
@@ -121,6 +129,7 @@ void shell_handle_char(char c) {
     // Handle Tab
     if (c == '\t') {
         handle_tab_completion(tty_num);
+        arena_reset(scratch_arena);
         return;
     }
 
@@ -182,6 +191,9 @@ void shell_handle_char(char c) {
             else if (strcmp(cmd, "snake") == 0) cmd_snake();
             else if (strcmp(cmd, "tetris") == 0) cmd_tetris();
             else if (strcmp(cmd, "meminfo") == 0) cmd_meminfo();
+            else if (strcmp(cmd, "slabinfo") == 0) cmd_slabinfo();
+            else if (strcmp(cmd, "heapstat") == 0) cmd_heapstat(args);
+            else if (strcmp(cmd, "bench") == 0) cmd_bench(args);
             else if (strcmp(cmd, "ls") == 0) cmd_ls(args);
             else if (strcmp(cmd, "cat") == 0) cmd_cat(args);
             else if (strcmp(cmd, "cd") == 0) cmd_cd(args);
@@ -193,6 +205,9 @@ void shell_handle_char(char c) {
                 console_write("'\nType 'help' for available commands.\n");
                 console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
             }
+            
+            // Everything the command allocated from scratch dies here
+            arena_reset(scratch_arena);
         }
         
         tty->buffer_index = 0;
@@ -244,6 +259,7 @@ void shell_draw(void) {}
 
 void shell_init(void) {
     init_shell_history();  // Initialize history arrays
+    scratch_arena = arena_create(SHELL_SCRATCH_PAGES);
     
     console_clear();
     console_set_color_preset(CONSOLE_COLOR_PRESET_MATRIX);
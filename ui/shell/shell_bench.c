@@ -0,0 +1,789 @@
+#include <ui/shell/shell_bench.h>
+#include <ui/console.h>
+#include <ui/fb_console.h>
+#include <drivers/video/framebuffer.h>
+#include <lib/string/string.h>
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/timer.h>
+#include <mm/pmm.h>
+#include <mm/heap.h>
+#include <mm/vmm.h>
+#include <mm/vmalloc.h>
+
+#define BENCH_SLOTS 256
+#define BENCH_OPS   4096
+
+static uint32_t bench_seed = 1;
+
+// Linear Congruential Generator, reseeded per run so every allocator
+// sees the same sequence of operations
+static uint32_t bench_rand(void) {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 16;
+}
+
+static void bench_write_result(const char* label, uint64_t cycles, uint32_t ops) {
+    console_write(label);
+    console_write_dec(ops ? (uint32_t)(cycles / ops) : 0);
+    console_write(" cycles/op\n");
+}
+
+// Reference allocator: the first-fit bitmap scan the PMM used before the
+// buddy allocator, run over a private bitmap with the same 16MB reserved
+// at the bottom so the scan pays the same cost it did in the kernel
+#define REF_PAGES    16384
+#define REF_RESERVED 4096
+static uint32_t ref_bitmap[REF_PAGES / 32];
+
+static inline int ref_test(uint32_t bit) {
+    return (ref_bitmap[bit / 32] & (1u << (bit % 32))) != 0;
+}
+
+static inline void ref_set(uint32_t bit, int used) {
+    if (used) {
+        ref_bitmap[bit / 32] |= (1u << (bit % 32));
+    } else {
+        ref_bitmap[bit / 32] &= ~(1u << (bit % 32));
+    }
+}
+
+static int ref_find_free_pages(size_t count) {
+    uint32_t found = 0;
+    int start = -1;
+    
+    for (uint32_t page = 0; page < REF_PAGES; page++) {
+        if (!ref_test(page)) {
+            if (start == -1) {
+                start = page;
+            }
+            found++;
+            
+            if (found == count) {
+                return start;
+            }
+        } else {
+            start = -1;
+            found = 0;
+        }
+    }
+    
+    return -1;
+}
+
+static uint64_t ref_alloc(size_t count) {
+    int start = ref_find_free_pages(count);
+    if (start == -1) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ref_set(start + i, 1);
+    }
+    return (uint64_t)start * PAGE_SIZE;
+}
+
+static void ref_free(uint64_t addr, size_t count) {
+    uint32_t start = addr / PAGE_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        ref_set(start + i, 0);
+    }
+}
+
+static void ref_fragmentation(uint32_t* free_pages, uint32_t* largest_run) {
+    uint32_t run = 0;
+    *free_pages = 0;
+    *largest_run = 0;
+    
+    for (uint32_t page = 0; page < REF_PAGES; page++) {
+        if (ref_test(page)) {
+            run = 0;
+            continue;
+        }
+        (*free_pages)++;
+        run++;
+        if (run > *largest_run) {
+            *largest_run = run;
+        }
+    }
+}
+
+typedef struct {
+    uint64_t alloc_cycles;
+    uint64_t free_cycles;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failed;
+} bench_stats_t;
+
+// Random alloc/free churn of 1-16 page runs over a fixed set of slots.
+// The live set is left allocated so fragmentation can be measured.
+static void bench_pmm_churn(int use_ref, uint64_t* addrs, size_t* counts,
+                            bench_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    bench_seed = 1;
+    
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        addrs[i] = 0;
+        counts[i] = 0;
+    }
+    
+    for (int op = 0; op < BENCH_OPS; op++) {
+        uint32_t slot = bench_rand() % BENCH_SLOTS;
+        size_t count = 1 + (bench_rand() % 16);
+        
+        if (addrs[slot]) {
+            uint64_t start = rdtsc();
+            if (use_ref) {
+                ref_free(addrs[slot], counts[slot]);
+            } else {
+                pmm_free_pages(addrs[slot], counts[slot]);
+            }
+            stats->free_cycles += rdtsc() - start;
+            stats->frees++;
+            addrs[slot] = 0;
+        } else {
+            uint64_t start = rdtsc();
+            uint64_t addr = use_ref ? ref_alloc(count) : pmm_alloc_pages(count);
+            stats->alloc_cycles += rdtsc() - start;
+            stats->allocs++;
+            
+            if (!addr) {
+                stats->failed++;
+                continue;
+            }
+            addrs[slot] = addr;
+            counts[slot] = count;
+        }
+    }
+}
+
+static void bench_pmm_release(int use_ref, uint64_t* addrs, size_t* counts) {
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        if (!addrs[i]) continue;
+        if (use_ref) {
+            ref_free(addrs[i], counts[i]);
+        } else {
+            pmm_free_pages(addrs[i], counts[i]);
+        }
+    }
+}
+
+static void bench_pmm_report(const char* name, bench_stats_t* stats,
+                             uint32_t free_pages, uint32_t largest) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write(name);
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    bench_write_result("    Alloc:   ", stats->alloc_cycles, stats->allocs);
+    bench_write_result("    Free:    ", stats->free_cycles, stats->frees);
+    console_write("    Failed:  ");
+    console_write_dec(stats->failed);
+    console_write("\n    Free:    ");
+    console_write_dec(free_pages);
+    console_write(" pages, largest run ");
+    console_write_dec(largest);
+    console_write(" pages\n");
+}
+
+static void bench_pmm(void) {
+    static uint64_t addrs[BENCH_SLOTS];
+    static size_t counts[BENCH_SLOTS];
+    bench_stats_t stats;
+    uint32_t free_pages, largest;
+    
+    console_write("\n╔══════════════ PMM Benchmark ══════════════╗\n");
+    console_write("  ");
+    console_write_dec(BENCH_OPS);
+    console_write(" random alloc/free ops, 1-16 pages each\n\n");
+    
+    // Bitmap scan reference
+    for (int i = 0; i < REF_PAGES / 32; i++) {
+        ref_bitmap[i] = 0;
+    }
+    for (int i = 0; i < REF_RESERVED; i++) {
+        ref_set(i, 1);
+    }
+    bench_pmm_churn(1, addrs, counts, &stats);
+    ref_fragmentation(&free_pages, &largest);
+    bench_pmm_report("  Bitmap scan (reference):\n", &stats, free_pages, largest);
+    bench_pmm_release(1, addrs, counts);
+    
+    // Buddy allocator
+    bench_pmm_churn(0, addrs, counts, &stats);
+    free_pages = pmm_get_free_memory() / PAGE_SIZE;
+    largest = pmm_get_largest_free_block() / PAGE_SIZE;
+    bench_pmm_report("  Buddy allocator (PMM):\n", &stats, free_pages, largest);
+    bench_pmm_release(0, addrs, counts);
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+}
+
+// Fill: take single pages until FILL_PAGES are held (or memory runs out),
+// free them all in shuffled order, then fill again over the scattered
+// holes. The second fill is where a scanning allocator slows down.
+#define FILL_PAGES (REF_PAGES - REF_RESERVED)
+
+typedef struct {
+    uint64_t fill_cycles[2];
+    uint64_t free_cycles;
+    uint32_t filled[2];
+} bench_fill_t;
+
+static uint32_t bench_fill_pages(int use_ref, uint64_t* pages, uint64_t* cycles) {
+    uint32_t filled = 0;
+    uint64_t start = rdtsc();
+    
+    while (filled < FILL_PAGES) {
+        uint64_t addr = use_ref ? ref_alloc(1) : pmm_alloc_page();
+        if (!addr) break;
+        pages[filled++] = addr;
+    }
+    
+    *cycles = rdtsc() - start;
+    return filled;
+}
+
+static uint64_t bench_free_shuffled(int use_ref, uint64_t* pages, uint32_t count) {
+    // Fisher-Yates shuffle, outside the timed section
+    for (uint32_t i = count; i > 1; i--) {
+        uint32_t j = bench_rand() % i;
+        uint64_t tmp = pages[i - 1];
+        pages[i - 1] = pages[j];
+        pages[j] = tmp;
+    }
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        if (use_ref) {
+            ref_free(pages[i], 1);
+        } else {
+            pmm_free_page(pages[i]);
+        }
+    }
+    return rdtsc() - start;
+}
+
+static void bench_pmm_fill(int use_ref, uint64_t* pages, bench_fill_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    bench_seed = 1;
+    
+    stats->filled[0] = bench_fill_pages(use_ref, pages, &stats->fill_cycles[0]);
+    stats->free_cycles = bench_free_shuffled(use_ref, pages, stats->filled[0]);
+    stats->filled[1] = bench_fill_pages(use_ref, pages, &stats->fill_cycles[1]);
+    bench_free_shuffled(use_ref, pages, stats->filled[1]);
+}
+
+static void bench_pmm_fill_report(const char* name, bench_fill_t* stats) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write(name);
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    bench_write_result("    Fill:    ", stats->fill_cycles[0], stats->filled[0]);
+    bench_write_result("    Free:    ", stats->free_cycles, stats->filled[0]);
+    bench_write_result("    Refill:  ", stats->fill_cycles[1], stats->filled[1]);
+    console_write("    Pages:   ");
+    console_write_dec(stats->filled[0]);
+    console_write(" / ");
+    console_write_dec(stats->filled[1]);
+    console_write("\n");
+}
+
+static void bench_pmm_random(void) {
+    bench_fill_t stats;
+    
+    // Only needed while the bench runs, so not kept in BSS
+    uint64_t* pages = vmalloc(FILL_PAGES * sizeof(uint64_t));
+    if (!pages) {
+        console_write("\nbench: out of memory\n");
+        return;
+    }
+    
+    console_write("\n╔═══════════ PMM Fill Benchmark ════════════╗\n");
+    console_write("  ");
+    console_write_dec(FILL_PAGES);
+    console_write(" single pages, freed in random order\n\n");
+    
+    // Bitmap scan reference
+    for (int i = 0; i < REF_PAGES / 32; i++) {
+        ref_bitmap[i] = 0;
+    }
+    for (int i = 0; i < REF_RESERVED; i++) {
+        ref_set(i, 1);
+    }
+    bench_pmm_fill(1, pages, &stats);
+    bench_pmm_fill_report("  Bitmap scan (reference):\n", &stats);
+    
+    // Buddy allocator
+    bench_pmm_fill(0, pages, &stats);
+    bench_pmm_fill_report("  Buddy allocator (PMM):\n", &stats);
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+    vfree(pages);
+}
+
+// Reference heap: the single-list first-fit allocator kmalloc used before
+// size classes, with its whole-heap merge on every free
+#define REF_HEAP_SIZE (2 * 1024 * 1024)
+#define HEAP_OPS      8192
+
+typedef struct ref_block {
+    size_t size;
+    struct ref_block* next;
+    int is_free;
+} ref_block_t;
+
+static ref_block_t* ref_heap_list;
+
+// The arena is vmalloc'd for the run only (page aligned)
+static void ref_heap_init(void* arena) {
+    ref_heap_list = (ref_block_t*)arena;
+    ref_heap_list->size = REF_HEAP_SIZE - sizeof(ref_block_t);
+    ref_heap_list->next = NULL;
+    ref_heap_list->is_free = 1;
+}
+
+static void* ref_kmalloc(size_t size) {
+    size = (size + 15) & ~15;
+    
+    ref_block_t* block = ref_heap_list;
+    while (block && !(block->is_free && block->size >= size)) {
+        block = block->next;
+    }
+    if (!block) {
+        return NULL;
+    }
+    
+    if (block->size >= size + sizeof(ref_block_t) + 16) {
+        ref_block_t* rest = (ref_block_t*)((uint8_t*)block + sizeof(ref_block_t) + size);
+        rest->size = block->size - size - sizeof(ref_block_t);
+        rest->is_free = 1;
+        rest->next = block->next;
+        block->size = size;
+        block->next = rest;
+    }
+    
+    block->is_free = 0;
+    return (uint8_t*)block + sizeof(ref_block_t);
+}
+
+static void ref_kfree(void* ptr) {
+    ref_block_t* block = (ref_block_t*)((uint8_t*)ptr - sizeof(ref_block_t));
+    block->is_free = 1;
+    
+    ref_block_t* current = ref_heap_list;
+    while (current && current->next) {
+        if (current->is_free && current->next->is_free) {
+            current->size += sizeof(ref_block_t) + current->next->size;
+            current->next = current->next->next;
+        } else {
+            current = current->next;
+        }
+    }
+}
+
+// Mostly small objects with a tail of larger buffers
+static size_t bench_heap_size(void) {
+    uint32_t r = bench_rand() % 100;
+    if (r < 70) return 16 + bench_rand() % 112;
+    if (r < 95) return 128 + bench_rand() % 896;
+    return 1024 + bench_rand() % 7168;
+}
+
+static void bench_heap_churn(int use_ref, void** ptrs, bench_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    bench_seed = 1;
+    
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        ptrs[i] = NULL;
+    }
+    
+    for (int op = 0; op < HEAP_OPS; op++) {
+        uint32_t slot = bench_rand() % BENCH_SLOTS;
+        size_t size = bench_heap_size();
+        
+        if (ptrs[slot]) {
+            uint64_t start = rdtsc();
+            if (use_ref) {
+                ref_kfree(ptrs[slot]);
+            } else {
+                kfree(ptrs[slot]);
+            }
+            stats->free_cycles += rdtsc() - start;
+            stats->frees++;
+            ptrs[slot] = NULL;
+        } else {
+            uint64_t start = rdtsc();
+            ptrs[slot] = use_ref ? ref_kmalloc(size) : kmalloc(size);
+            stats->alloc_cycles += rdtsc() - start;
+            stats->allocs++;
+            
+            if (!ptrs[slot]) {
+                stats->failed++;
+            }
+        }
+    }
+    
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        if (!ptrs[i]) continue;
+        if (use_ref) {
+            ref_kfree(ptrs[i]);
+        } else {
+            kfree(ptrs[i]);
+        }
+    }
+}
+
+static void bench_heap_report(const char* name, bench_stats_t* stats) {
+    uint64_t cycles = stats->alloc_cycles + stats->free_cycles;
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write(name);
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    bench_write_result("    Alloc:   ", stats->alloc_cycles, stats->allocs);
+    bench_write_result("    Free:    ", stats->free_cycles, stats->frees);
+    bench_write_result("    Overall: ", cycles, stats->allocs + stats->frees);
+    console_write("    Failed:  ");
+    console_write_dec(stats->failed);
+    console_write("\n");
+}
+
+static void bench_heap(void) {
+    static void* ptrs[BENCH_SLOTS];
+    bench_stats_t stats;
+    
+    void* arena = vmalloc(REF_HEAP_SIZE);
+    if (!arena) {
+        console_write("\nbench: out of memory\n");
+        return;
+    }
+    
+    console_write("\n╔═════════════ Heap Benchmark ══════════════╗\n");
+    console_write("  ");
+    console_write_dec(HEAP_OPS);
+    console_write(" random kmalloc/kfree ops, 16 B - 8 KB\n\n");
+    
+    ref_heap_init(arena);
+    bench_heap_churn(1, ptrs, &stats);
+    bench_heap_report("  First fit (reference):\n", &stats);
+    
+    bench_heap_churn(0, ptrs, &stats);
+    bench_heap_report("  Size classes (kmalloc):\n", &stats);
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+    vfree(arena);
+}
+
+// VMM: map, remap and unmap a run of pages, once flushing the TLB page by
+// page and once inside a batch. The range sits between the heap limit and
+// the kernel image, where nothing else maps.
+#define VMM_BENCH_BASE  KERNEL_HEAP_LIMIT
+#define VMM_BENCH_PAGES 512
+
+typedef struct {
+    uint64_t map_cycles;
+    uint64_t remap_cycles;
+    uint64_t unmap_cycles;
+    vmm_flush_info_t flushes;
+} bench_vmm_t;
+
+static void bench_vmm_run(int batched, uint64_t phys, bench_vmm_t* stats) {
+    uint64_t flags = PAGE_PRESENT | PAGE_WRITABLE;
+    vmm_flush_info_t before, after;
+    uint64_t start;
+    
+    vmm_get_flush_info(&before);
+    
+    // Fresh mappings: nothing was present, so there is nothing to flush
+    start = rdtsc();
+    if (batched) vmm_batch_begin();
+    for (int i = 0; i < VMM_BENCH_PAGES; i++) {
+        vmm_map_page(VMM_BENCH_BASE + i * PAGE_SIZE, phys + i * PAGE_SIZE, flags);
+    }
+    if (batched) vmm_batch_end();
+    stats->map_cycles = rdtsc() - start;
+    
+    // Point every page at its neighbour's frame: live translations change
+    start = rdtsc();
+    if (batched) vmm_batch_begin();
+    for (int i = 0; i < VMM_BENCH_PAGES; i++) {
+        uint64_t frame = (i + 1) % VMM_BENCH_PAGES;
+        vmm_map_page(VMM_BENCH_BASE + i * PAGE_SIZE, phys + frame * PAGE_SIZE, flags);
+    }
+    if (batched) vmm_batch_end();
+    stats->remap_cycles = rdtsc() - start;
+    
+    start = rdtsc();
+    if (batched) vmm_batch_begin();
+    for (int i = 0; i < VMM_BENCH_PAGES; i++) {
+        vmm_unmap_page(VMM_BENCH_BASE + i * PAGE_SIZE);
+    }
+    if (batched) vmm_batch_end();
+    stats->unmap_cycles = rdtsc() - start;
+    
+    vmm_get_flush_info(&after);
+    stats->flushes.page_flushes = after.page_flushes - before.page_flushes;
+    stats->flushes.full_flushes = after.full_flushes - before.full_flushes;
+    stats->flushes.skipped = after.skipped - before.skipped;
+}
+
+static void bench_vmm_report(const char* name, bench_vmm_t* stats) {
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write(name);
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    bench_write_result("    Map:     ", stats->map_cycles, VMM_BENCH_PAGES);
+    bench_write_result("    Remap:   ", stats->remap_cycles, VMM_BENCH_PAGES);
+    bench_write_result("    Unmap:   ", stats->unmap_cycles, VMM_BENCH_PAGES);
+    console_write("    Flushes: ");
+    console_write_dec(stats->flushes.page_flushes);
+    console_write(" invlpg, ");
+    console_write_dec(stats->flushes.full_flushes);
+    console_write(" CR3 reloads, ");
+    console_write_dec(stats->flushes.skipped);
+    console_write(" skipped\n");
+}
+
+static void bench_vmm(void) {
+    bench_vmm_t stats;
+    
+    uint64_t phys = pmm_alloc_pages(VMM_BENCH_PAGES);
+    if (!phys) {
+        console_write("\nbench: out of memory\n");
+        return;
+    }
+    
+    console_write("\n╔══════════════ VMM Benchmark ══════════════╗\n");
+    console_write("  ");
+    console_write_dec(VMM_BENCH_PAGES);
+    console_write(" pages mapped, remapped, unmapped\n\n");
+    
+    // Warm up so the page tables exist before either run is timed
+    bench_vmm_run(0, phys, &stats);
+    
+    bench_vmm_run(0, phys, &stats);
+    bench_vmm_report("  Flush per page:\n", &stats);
+    
+    bench_vmm_run(1, phys, &stats);
+    bench_vmm_report("  Batched:\n", &stats);
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+    
+    pmm_free_pages(phys, VMM_BENCH_PAGES);
+}
+
+// Address space switch: bounce between the kernel PML4 and a second one,
+// touching a set of 4 KiB kernel pages after each switch. What a switch
+// costs is mostly the TLB refill that follows it.
+#define SWITCH_ROUNDS 2000
+#define SWITCH_PAGES  64
+
+static uint64_t bench_switch_run(page_table_t* kernel, page_table_t* other) {
+    volatile uint8_t* pages = (volatile uint8_t*)VMM_BENCH_BASE;
+    
+    uint64_t start = rdtsc();
+    for (int round = 0; round < SWITCH_ROUNDS; round++) {
+        vmm_switch_page_directory((round & 1) ? kernel : other);
+        for (int i = 0; i < SWITCH_PAGES; i++) {
+            (void)pages[i * PAGE_SIZE];
+        }
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    vmm_switch_page_directory(kernel);
+    return cycles;
+}
+
+static void bench_switch(void) {
+    static const struct {
+        const char* label;
+        uint32_t features;
+    } modes[] = {
+        { "    Plain CR3 load:  ", 0 },
+        { "    Global pages:    ", VMM_TLB_GLOBAL },
+        { "    Global + PCID:   ", VMM_TLB_GLOBAL | VMM_TLB_PCID },
+    };
+    
+    page_table_t* kernel = vmm_get_kernel_pml4();
+    uint64_t phys = pmm_alloc_pages(SWITCH_PAGES);
+    if (!phys) {
+        console_write("\nbench: out of memory\n");
+        return;
+    }
+    
+    vmm_batch_begin();
+    for (int i = 0; i < SWITCH_PAGES; i++) {
+        vmm_map_page(VMM_BENCH_BASE + i * PAGE_SIZE, phys + i * PAGE_SIZE,
+                     PAGE_PRESENT | PAGE_WRITABLE);
+    }
+    vmm_batch_end();
+    
+    page_table_t* other = vmm_create_address_space();
+    if (!other) {
+        vmm_unmap_range(VMM_BENCH_BASE, SWITCH_PAGES * PAGE_SIZE);
+        pmm_free_pages(phys, SWITCH_PAGES);
+        console_write("\nbench: out of memory\n");
+        return;
+    }
+    
+    console_write("\n╔═══════════ Switch Benchmark ══════════════╗\n");
+    console_write("  ");
+    console_write_dec(SWITCH_ROUNDS);
+    console_write(" switches, ");
+    console_write_dec(SWITCH_PAGES);
+    console_write(" pages touched after each\n\n");
+    
+    uint32_t saved = vmm_get_tlb_features();
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        console_write(modes[i].label);
+        if (vmm_set_tlb_features(modes[i].features) != modes[i].features) {
+            console_write("not supported\n");
+            continue;
+        }
+        bench_write_result("", bench_switch_run(kernel, other), SWITCH_ROUNDS);
+    }
+    vmm_set_tlb_features(saved);
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+    
+    vmm_destroy_address_space(other);
+    vmm_unmap_range(VMM_BENCH_BASE, SWITCH_PAGES * PAGE_SIZE);
+    pmm_free_pages(phys, SWITCH_PAGES);
+}
+
+// Framebuffer: full-screen clears and console scrolls with the framebuffer
+// at its default memory type, then write-combining. The screen is wiped
+// before the results are shown.
+#define FB_CLEARS  16
+#define FB_SCROLLS 64
+
+static void bench_fb_run(struct framebuffer* fb, uint64_t* clear_cycles,
+                         uint64_t* scroll_cycles) {
+    uint64_t start = rdtsc();
+    for (int i = 0; i < FB_CLEARS; i++) {
+        fb_clear(fb, 0, 0, (i & 1) ? 64 : 0);
+    }
+    *clear_cycles = rdtsc() - start;
+    
+    start = rdtsc();
+    for (int i = 0; i < FB_SCROLLS; i++) {
+        fb_console_scroll();
+    }
+    *scroll_cycles = rdtsc() - start;
+}
+
+static void bench_fb(void) {
+    struct framebuffer* fb = fb_get_current();
+    uint64_t clear[2], scroll[2];
+    
+    if (!fb || fb_set_write_combining(fb, false) != 0) {
+        console_write("\nbench: no framebuffer\n");
+        return;
+    }
+    bench_fb_run(fb, &clear[0], &scroll[0]);
+    
+    int wc = fb_set_write_combining(fb, true) == 0;
+    if (wc) {
+        bench_fb_run(fb, &clear[1], &scroll[1]);
+    }
+    
+    console_clear();
+    console_write("\n╔═══════════ Framebuffer Benchmark ═════════╗\n");
+    console_write("  ");
+    console_write_dec(fb->width);
+    console_write("x");
+    console_write_dec(fb->height);
+    console_write(", ");
+    console_write_dec(FB_CLEARS);
+    console_write(" clears, ");
+    console_write_dec(FB_SCROLLS);
+    console_write(" scrolls\n\n");
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("  Default memory type:\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    bench_write_result("    Clear:   ", clear[0], FB_CLEARS);
+    bench_write_result("    Scroll:  ", scroll[0], FB_SCROLLS);
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("  Write-combining:\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    if (wc) {
+        bench_write_result("    Clear:   ", clear[1], FB_CLEARS);
+        bench_write_result("    Scroll:  ", scroll[1], FB_SCROLLS);
+    } else {
+        console_write("    Could not remap the framebuffer\n");
+    }
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+}
+
+// Clock read cost, and whether back-to-back reads ever step backwards
+#define CLOCK_SLEEP_MS 10
+
+static void bench_clock(void) {
+    uint32_t backwards = 0;
+    uint64_t last = clock_monotonic_ns();
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        uint64_t now = clock_monotonic_ns();
+        if (now < last) {
+            backwards++;
+        }
+        last = now;
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    uint64_t sleep_start = clock_monotonic_ns();
+    timer_sleep_ms(CLOCK_SLEEP_MS);
+    uint64_t slept = clock_monotonic_ns() - sleep_start;
+    
+    console_write("\n╔══════════════ Clock Benchmark ════════════╗\n");
+    bench_write_result("  clock_monotonic_ns: ", cycles, BENCH_OPS);
+    console_write("  Backward steps:     ");
+    console_write_dec(backwards);
+    console_write("\n  Sleep ");
+    console_write_dec(CLOCK_SLEEP_MS);
+    console_write(" ms took:   ");
+    console_write_dec((uint32_t)(slept / 1000));
+    console_write(" us\n");
+    console_write("╚═══════════════════════════════════════════╝\n");
+}
+
+void cmd_bench(const char* args) {
+    if (args && strcmp(args, "pmm") == 0) {
+        bench_pmm();
+        return;
+    }
+    if (args && strcmp(args, "pmm-random") == 0) {
+        bench_pmm_random();
+        return;
+    }
+    if (args && strcmp(args, "heap") == 0) {
+        bench_heap();
+        return;
+    }
+    if (args && strcmp(args, "vmm") == 0) {
+        bench_vmm();
+        return;
+    }
+    if (args && strcmp(args, "switch") == 0) {
+        bench_switch();
+        return;
+    }
+    if (args && strcmp(args, "fb") == 0) {
+        bench_fb();
+        return;
+    }
+    if (args && strcmp(args, "clock") == 0) {
+        bench_clock();
+        return;
+    }
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+    console_write("\nUsage: bench <name>\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    console_write("  pmm        - Physical page allocator alloc/free churn\n");
+    console_write("  pmm-random - Single-page fill, random-order free, refill\n");
+    console_write("  heap       - kmalloc/kfree churn with mixed sizes\n");
+    console_write("  vmm        - Map/remap/unmap, per-page vs batched TLB flush\n");
+    console_write("  switch     - Address space switch, plain vs global pages/PCID\n");
+    console_write("  fb         - Framebuffer clear/scroll, default vs write-combining\n");
+    console_write("  clock      - clock_monotonic_ns read cost and sleep accuracy\n");
+}
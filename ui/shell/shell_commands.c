@@ -2,8 +2,16 @@
 #include <ui/shell/shell_history.h>
 #include <ui/console.h>
 #include <arch/x86_64/idt.h>
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/timer_wheel.h>
 #include <mm/pmm.h>
 #include <mm/heap.h>
+#include <mm/vmm.h>
+#include <mm/vmalloc.h>
+#include <mm/slab.h>
+#include <mm/arena.h>
+#include <ui/shell/shell.h>
+#include <lib/string/string.h>
 #include <ui/terminal_games/game_snake/game_snake.h>
 #include <ui/terminal_games/game_tetris/game_tetris.h>
 #include <ui/tty/tty.h>
@@ -28,6 +36,9 @@ void cmd_help(void) {
     console_write("  snake      - Play Snake game\n");
     console_write("  tetris     - Play Tetris game\n");
     console_write("  meminfo    - Show memory information\n");
+    console_write("  slabinfo   - Show slab cache statistics\n");
+    console_write("  heapstat   - Show heap usage by caller (on/off)\n");
+    console_write("  bench      - Run kernel benchmarks\n");
     console_write("\nTip: Use TAB for command completion\n");
     console_write("     Use UP/DOWN arrows for command history\n");
     console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
@@ -81,16 +92,14 @@ void cmd_version(void) {
 }
 
 void cmd_uptime(void) {
-    uint32_t ticks = get_timer_ticks();
-    uint32_t seconds = ticks / 18;
-    uint32_t minutes = seconds / 60;
-    uint32_t hours = minutes / 60;
+    uint64_t seconds = clock_monotonic_ns() / 1000000000ULL;
+    uint64_t minutes = seconds / 60;
+    uint64_t hours = minutes / 60;
     
     console_write("\nUptime: ");
     
     if (hours > 0) {
-        console_putchar('0' + (hours / 10));
-        console_putchar('0' + (hours % 10));
+        console_write_dec((uint32_t)hours);
         console_write("h ");
     }
     
@@ -101,6 +110,14 @@ void cmd_uptime(void) {
     console_putchar('0' + ((seconds % 60) / 10));
     console_putchar('0' + ((seconds % 60) % 10));
     console_write("s\n");
+    
+    timer_wheel_info_t timers;
+    timer_wheel_get_info(&timers);
+    console_write("Timers: ");
+    console_write_dec(timers.pending);
+    console_write(" pending, ");
+    console_write_dec((uint32_t)timers.fired);
+    console_write(" fired\n");
 }
 
 void cmd_echo(const char* args) {
@@ -241,7 +258,7 @@ void cmd_miko(void) {
 void cmd_snake(void) {
     // Change current TTY to snake game mode
     tty_change_mode(TTY_MODE_GAME,
-                   snake_update,
+                   NULL,
                    snake_draw,
                    snake_input,
                    snake_special_input);
@@ -251,7 +268,7 @@ void cmd_snake(void) {
 void cmd_tetris(void) {
     // Change current TTY to tetris game mode
     tty_change_mode(TTY_MODE_GAME,
-                   tetris_update,
+                   NULL,
                    tetris_draw,
                    tetris_input,
                    tetris_special_input);
@@ -264,28 +281,71 @@ void cmd_meminfo(void) {
     // Physical Memory
     console_write("  Physical Memory:\n");
     console_write("    Total:  ");
-    uint64_t total_mb = pmm_get_total_memory() / (1024 * 1024);
-    if (total_mb >= 1000) console_putchar('0' + (total_mb / 1000));
-    if (total_mb >= 100) console_putchar('0' + ((total_mb / 100) % 10));
-    if (total_mb >= 10) console_putchar('0' + ((total_mb / 10) % 10));
-    console_putchar('0' + (total_mb % 10));
+    console_write_dec(pmm_get_total_memory() / (1024 * 1024));
     console_write(" MB\n");
     
     console_write("    Used:   ");
-    uint64_t used_mb = pmm_get_used_memory() / (1024 * 1024);
-    if (used_mb >= 1000) console_putchar('0' + (used_mb / 1000));
-    if (used_mb >= 100) console_putchar('0' + ((used_mb / 100) % 10));
-    if (used_mb >= 10) console_putchar('0' + ((used_mb / 10) % 10));
-    console_putchar('0' + (used_mb % 10));
-console_write(" MB\n");
+    console_write_dec(pmm_get_used_memory() / (1024 * 1024));
+    console_write(" MB\n");
     
     console_write("    Free:   ");
-    uint64_t free_mb = pmm_get_free_memory() / (1024 * 1024);
-    if (free_mb >= 1000) console_putchar('0' + (free_mb / 1000));
-    if (free_mb >= 100) console_putchar('0' + ((free_mb / 100) % 10));
-    if (free_mb >= 10) console_putchar('0' + ((free_mb / 10) % 10));
-    console_putchar('0' + (free_mb % 10));
-    console_write(" MB\n\n");
+    console_write_dec(pmm_get_free_memory() / (1024 * 1024));
+    console_write(" MB\n");
+    
+    console_write("    Kernel: ");
+    console_write_dec(pmm_get_type_memory(PG_KERNEL) / 1024);
+    console_write(" KB, Page tables: ");
+    console_write_dec(pmm_get_type_memory(PG_PAGETABLE) / 1024);
+    console_write(" KB\n");
+    
+    console_write("    Heap:   ");
+    console_write_dec(pmm_get_type_memory(PG_HEAP) / 1024);
+    console_write(" KB, Slab: ");
+    console_write_dec(pmm_get_type_memory(PG_SLAB) / 1024);
+    console_write(" KB\n");
+    
+    console_write("    File:   ");
+    console_write_dec(pmm_get_type_memory(PG_FILE) / 1024);
+    console_write(" KB\n\n");
+    
+    // Zones
+    console_write("  Zones (free / total KB, low/high watermark):\n");
+    pmm_zone_info_t zone;
+    for (int i = 0; pmm_get_zone_info(i, &zone) == 0; i++) {
+        if (zone.total_pages == 0) continue;
+        
+        console_write("    ");
+        console_write(zone.name);
+        console_write(": ");
+        console_write_dec(zone.free_pages * PAGE_SIZE / 1024);
+        console_write(" / ");
+        console_write_dec(zone.total_pages * PAGE_SIZE / 1024);
+        console_write(", ");
+        console_write_dec(zone.low_pages * PAGE_SIZE / 1024);
+        console_write("/");
+        console_write_dec(zone.high_pages * PAGE_SIZE / 1024);
+        if (zone.free_pages < zone.high_pages) {
+            console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
+            console_write(" (low)");
+            console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+        }
+        console_write("\n");
+    }
+    
+    pmm_zero_pool_info_t pool;
+    pmm_get_zero_pool_info(&pool);
+    console_write("    Zeroed pool: ");
+    console_write_dec(pool.pages);
+    console_write(" pages (");
+    console_write_dec(pool.pages * PAGE_SIZE / 1024);
+    console_write(" KB, not in used/free), ");
+    console_write_dec(pool.hits);
+    console_write(" hits, ");
+    console_write_dec(pool.misses);
+    console_write(" misses\n");
+    console_write("    Demand-zero faults: ");
+    console_write_dec(vmm_get_demand_faults());
+    console_write("\n\n");
     
     // Heap Memory
     console_write("  Kernel Heap:\n");
@@ -307,9 +367,140 @@ console_write(" MB\n");
     console_putchar('0' + (heap_free_kb % 10));
     console_write(" KB\n");
     
+    console_write("    Largest free block: ");
+    console_write_dec(heap_get_largest_free() / 1024);
+    console_write(" KB (");
+    console_write_dec(heap_get_fragmentation());
+    console_write("% fragmented)\n\n");
+    
+    vmalloc_info_t vinfo;
+    vmalloc_get_info(&vinfo);
+    console_write("  vmalloc:\n");
+    console_write("    ");
+    console_write_dec(vinfo.areas);
+    console_write(" areas, ");
+    console_write_dec(vinfo.reserved_bytes / 1024);
+    console_write(" KB reserved, ");
+    console_write_dec(vinfo.mapped_bytes / 1024);
+    console_write(" KB mapped\n");
+    
     console_write("╚════════════════════════════════════════════════╝\n");
 }
 
+void cmd_slabinfo(void) {
+    console_write("\n╔══════════════ Slab Caches ══════════════╗\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("  name              size  active/total  slabs\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    
+    kmem_cache_info_t info;
+    for (int i = 0; kmem_cache_get_info(i, &info) == 0; i++) {
+        console_write("  ");
+        console_write(info.name);
+        for (size_t pad = strlen(info.name); pad < 16; pad++) {
+            console_putchar(' ');
+        }
+        console_write_dec(info.stride);
+        console_write("  ");
+        console_write_dec(info.active_objects);
+        console_write("/");
+        console_write_dec(info.slabs * info.objects_per_slab);
+        console_write("  ");
+        console_write_dec(info.slabs);
+        console_write(" x ");
+        console_write_dec(info.slab_pages);
+        console_write(" pages\n");
+    }
+    
+    console_write("╚═════════════════════════════════════════╝\n");
+}
+
+#define HEAPSTAT_TOP 10
+
+void cmd_heapstat(const char* args) {
+    if (args && strcmp(args, "on") == 0) {
+        heap_profile_enable(1);
+        console_write("\nHeap profiling on\n");
+        return;
+    }
+    if (args && strcmp(args, "off") == 0) {
+        heap_profile_enable(0);
+        console_write("\nHeap profiling off\n");
+        return;
+    }
+    
+    static const char* bucket_names[HEAP_HIST_BUCKETS] = {
+        "32", "128", "512", "2K", "8K", "32K", "128K", "big"
+    };
+    
+    console_write("\n╔═══════════════ Kernel Heap ═══════════════╗\n");
+    console_write("  Used: ");
+    console_write_dec(heap_get_used() / 1024);
+    console_write(" KB (peak ");
+    console_write_dec(heap_get_peak() / 1024);
+    console_write(" KB), Free: ");
+    console_write_dec(heap_get_free() / 1024);
+    console_write(" KB\n");
+    console_write("  Largest free block: ");
+    console_write_dec(heap_get_largest_free() / 1024);
+    console_write(" KB (");
+    console_write_dec(heap_get_fragmentation());
+    console_write("% fragmented)\n");
+    
+    if (!heap_profile_enabled()) {
+        console_write("  Profiling is off ('heapstat on' to tag allocations)\n");
+    }
+    
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CYAN);
+    console_write("  caller              live B      peak B  allocs/frees\n");
+    console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
+    
+    // Top consumers by live bytes, picked one at a time
+    uint8_t shown[HEAP_PROFILE_TAGS] = {0};
+    for (int rank = 0; rank < HEAPSTAT_TOP; rank++) {
+        heap_tag_info_t info;
+        heap_tag_info_t best;
+        int best_index = -1;
+        
+        for (int i = 0; heap_get_tag_info(i, &info) == 0; i++) {
+            if (shown[i]) continue;
+            if (best_index < 0 || info.live_bytes > best.live_bytes) {
+                best = info;
+                best_index = i;
+            }
+        }
+        if (best_index < 0) break;
+        shown[best_index] = 1;
+        
+        console_write("  ");
+        if (best.caller) {
+            console_write_hex64(best.caller);
+        } else {
+            console_write("(other)           ");
+        }
+        console_write("  ");
+        console_write_dec(best.live_bytes);
+        console_write("  ");
+        console_write_dec(best.peak_bytes);
+        console_write("  ");
+        console_write_dec(best.allocs);
+        console_write("/");
+        console_write_dec(best.frees);
+        console_write("\n     ");
+        
+        for (int b = 0; b < HEAP_HIST_BUCKETS; b++) {
+            if (!best.histogram[b]) continue;
+            console_write(" ");
+            console_write(bucket_names[b]);
+            console_write(":");
+            console_write_dec(best.histogram[b]);
+        }
+        console_write("\n");
+    }
+    
+    console_write("╚═══════════════════════════════════════════╝\n");
+}
+
 
 void cmd_ls(const char* args) {
     vfs_node_t* dir;
@@ -398,6 +589,8 @@ void cmd_ls(const char* args) {
     console_write(" items\n");
 }
 
+#define CAT_BUFFER_SIZE 4096
+
 void cmd_cat(const char* args) {
     if (!args || args[0] == '\0') {
         console_set_color_preset(CONSOLE_COLOR_PRESET_RED);
@@ -425,10 +618,10 @@ void cmd_cat(const char* args) {
     console_set_color_preset(CONSOLE_COLOR_PRESET_CLASSIC);
     
     // Read and display file contents
-    char buffer[512];
+    char* buffer = arena_alloc(shell_scratch(), CAT_BUFFER_SIZE);
     int bytes_read;
     
-    while ((bytes_read = vfs_read(fd, buffer, sizeof(buffer) - 1)) > 0) {
+    while (buffer && (bytes_read = vfs_read(fd, buffer, CAT_BUFFER_SIZE - 1)) > 0) {
         buffer[bytes_read] = '\0';
         console_write(buffer);
     }
@@ -4,6 +4,7 @@
 #include <ui/console.h>
 #include <drivers/input/keyboard.h>
 #include <ui/tty/tty.h>
+#include <mm/arena.h>
 
 
 static int starts_with(const char* str, const char* prefix) {
@@ -19,7 +20,7 @@ char temp_buffer[MAX_TTYS][SHELL_BUFFER_SIZE];
 // Available commands for tab completion
 static const char* available_commands[] = {
     "help", "clear", "about", "lfetch", "version", "uptime", "echo", "colors",
-    "cute-girl", "history", "reboot", "miko", "snake", "tetris", "meminfo", NULL
+    "cute-girl", "history", "reboot", "miko", "snake", "tetris", "meminfo", "slabinfo", "heapstat", "bench", NULL
 };
 
 void init_shell_history(void) {
@@ -152,7 +153,8 @@ static void complete_filesystem_path(int tty_num, const char* partial) {
     // Count matches
     int match_count = 0;
     vfs_node_t* first_match = NULL;
-    char matches[32][256];  // Store up to 32 matches
+    char (*matches)[256] = arena_alloc(shell_scratch(), 32 * 256);  // Store up to 32 matches
+    if (!matches) return;
     int match_idx = 0;
     
     uint32_t index = 0;
@@ -2,13 +2,15 @@
 #include <ui/console.h>
 #include <drivers/input/keyboard.h>
 #include <ui/tty/tty.h>
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/timer_wheel.h>
 #include <arch/x86_64/idt.h>
 #include <arch/x86_64/irq.h>
 
 #define GRID_WIDTH 40
 #define GRID_HEIGHT 20
 #define MAX_SNAKE_LENGTH 800
-#define SNAKE_UPDATE_INTERVAL 10
+#define SNAKE_UPDATE_INTERVAL 120    // ms per step
 
 typedef struct {
     int x, y;
@@ -23,7 +25,9 @@ static int game_over;
 static int game_running = 0;
 static int initialized = 0;
 static int needs_redraw = 1;
-static int update_counter = 0;
+static ktimer_t snake_timer;
+
+static void snake_tick(void* data);
 
 // random number generation using timer
 static void spawn_food(void) {
@@ -153,21 +157,15 @@ void snake_init(void) {
     game_running = 1;
     initialized = 0;
     needs_redraw = 1;
-    update_counter = 0;
     
     spawn_food();
+    
+    timer_del(&snake_timer);
+    timer_setup(&snake_timer, snake_tick, NULL);
+    timer_add(&snake_timer, timer_get_ms() + SNAKE_UPDATE_INTERVAL);
 }
 
-void snake_update(void) {
-    if (!game_running) return;
-    
-    // Only update every SNAKE_UPDATE_INTERVAL calls to slow down the snake
-    update_counter++;
-    if (update_counter < SNAKE_UPDATE_INTERVAL) {
-        return;
-    }
-    update_counter = 0;
-    
+static void snake_step(void) {
     if (game_over) {
         needs_redraw = 1;
         return;
@@ -218,6 +216,16 @@ void snake_update(void) {
     needs_redraw = 1;
 }
 
+// Timer callback: one step every SNAKE_UPDATE_INTERVAL ms while running
+static void snake_tick(void* data) {
+    (void)data;
+    
+    if (!game_running) return;
+    
+    snake_step();
+    timer_add(&snake_timer, timer_get_ms() + SNAKE_UPDATE_INTERVAL);
+}
+
 void snake_draw(void) {
     if (!initialized) {
         console_clear();
@@ -235,6 +243,7 @@ void snake_draw(void) {
 void snake_input(char c) {
     if (c == 27) {  // ESC
         game_running = 0;
+        timer_del(&snake_timer);
         // Restore to shell
         tty_restore_to_shell();
     } else if (c == 'r' || c == 'R') {
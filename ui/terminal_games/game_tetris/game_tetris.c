@@ -3,10 +3,12 @@
 #include <drivers/input/keyboard.h>
 #include <arch/x86_64/irq.h>
 #include <ui/tty/tty.h>
+#include <arch/x86_64/timer.h>
+#include <arch/x86_64/timer_wheel.h>
 
 #define BOARD_WIDTH 10
 #define BOARD_HEIGHT 20
-#define TETRIS_UPDATE_INTERVAL 20
+#define TETRIS_UPDATE_INTERVAL 500   // ms per row the piece falls
 
 static uint8_t board[BOARD_HEIGHT][BOARD_WIDTH];
 static uint32_t score;  
@@ -14,7 +16,9 @@ static int game_over;
 static int game_running = 0;
 static int initialized = 0;
 static int needs_redraw = 1;
-static int update_counter = 0;
+static ktimer_t tetris_timer;
+
+static void tetris_tick(void* data);
 
 // Tetromino data
 static int current_piece_x;
@@ -162,21 +166,15 @@ void tetris_init(void) {
     game_running = 1;
     initialized = 0;
     needs_redraw = 1;
-    update_counter = 0;
     
     spawn_new_piece();
+    
+    timer_del(&tetris_timer);
+    timer_setup(&tetris_timer, tetris_tick, NULL);
+    timer_add(&tetris_timer, timer_get_ms() + TETRIS_UPDATE_INTERVAL);
 }
 
-void tetris_update(void) {
-    if (!game_running) return;
-    
-    // Only update every TETRIS_UPDATE_INTERVAL calls to slow down
-    update_counter++;
-    if (update_counter < TETRIS_UPDATE_INTERVAL) {
-        return;
-    }
-    update_counter = 0;
-    
+static void tetris_step(void) {
     if (game_over) {
         needs_redraw = 1;
         return;
@@ -194,6 +192,16 @@ void tetris_update(void) {
     }
 }
 
+// Timer callback: drop the piece every TETRIS_UPDATE_INTERVAL ms while running
+static void tetris_tick(void* data) {
+    (void)data;
+    
+    if (!game_running) return;
+    
+    tetris_step();
+    timer_add(&tetris_timer, timer_get_ms() + TETRIS_UPDATE_INTERVAL);
+}
+
 void tetris_draw(void) {
     if (!initialized) {
         console_clear();
@@ -211,6 +219,7 @@ void tetris_draw(void) {
 void tetris_input(char c) {
     if (c == 27) {  // ESC
         game_running = 0;
+        timer_del(&tetris_timer);
         // Restore to shell
         tty_restore_to_shell();
     } else if (c == ' ') {  // Space - hard drop